@@ -139,6 +139,16 @@ block_write (struct block *block, block_sector_t sector, const void *buffer)
   block->write_cnt++;
 }
 
+/* Makes every sector written to BLOCK so far durable, emptying
+   the device's own write cache if it has one.  Returns once the
+   device reports that it is done. */
+void
+block_flush (struct block *block)
+{
+  if (block->ops->flush != NULL)
+    block->ops->flush (block->aux);
+}
+
 /* Returns the number of sectors in BLOCK. */
 block_sector_t
 block_size (struct block *block)
@@ -13,6 +13,12 @@
 #include "devices/block.h"
 #include "filesys/filesys.h"
 #endif
+#ifdef VM
+#include "vm/aio.h"
+#include "vm/ksm.h"
+#include "vm/pagecache.h"
+#include "vm/prefetch.h"
+#endif
 
 /* Keyboard control register port. */
 #define CONTROL_REG 0x64
@@ -90,6 +96,9 @@ shutdown_power_off (void)
   const char s[] = "Shutdown";
   const char *p;
 
+#ifdef VM
+  pcache_done ();
+#endif
 #ifdef FILESYS
   filesys_done ();
 #endif
@@ -130,4 +139,10 @@ print_stats (void)
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef VM
+  prefetch_print_stats ();
+  ksm_print_stats ();
+  pcache_print_stats ();
+  aio_print_stats ();
+#endif
 }
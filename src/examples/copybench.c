@@ -0,0 +1,129 @@
+/* copybench.c
+
+   File copy benchmark.  Creates a SIZE-byte source file, then
+   copies it either with a read/write loop through a user buffer
+   or with copy_file_range(), which moves the data inside the
+   kernel, and checks the copy.
+
+   User programs have no clock, so run it with "pintos -q" once
+   per METHOD and compare the tick counts printed at shutdown.
+   METHOD "none" does everything but the copy, checking the
+   source instead, so subtracting its ticks from those of "rw"
+   and "kernel" leaves the cost of the copy alone.  Source and
+   copy take twice SIZE bytes, so give pintos a file system disk
+   of a few MB.
+
+   Usage: copybench [METHOD [SIZE]]
+   where METHOD is "rw", "kernel" or "none". */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Names of the source and the copy. */
+#define SRC_NAME "copybench.src"
+#define DST_NAME "copybench.dst"
+
+/* Default file size in bytes. */
+#define DEFAULT_SIZE (1024 * 1024)
+
+/* Size of the user buffer of the read/write loop and of the
+   writes that fill the source. */
+#define CHUNK 4096
+
+static char buf[CHUNK];
+
+/* Creates NAME empty and opens it, or exits on failure. */
+static int
+create_open (const char *name)
+{
+  int fd;
+
+  remove (name);
+  if (!create (name, 0) || (fd = open (name)) < 0)
+    {
+      printf ("copybench: cannot create %s\n", name);
+      exit (EXIT_FAILURE);
+    }
+  return fd;
+}
+
+int
+main (int argc, char *argv[])
+{
+  const char *method = argc > 1 ? argv[1] : "kernel";
+  int size = argc > 2 ? atoi (argv[2]) : DEFAULT_SIZE;
+  int src, dst;
+  int copied = 0;
+  int check;
+  int ofs;
+
+  if (strcmp (method, "rw") && strcmp (method, "kernel")
+      && strcmp (method, "none"))
+    {
+      printf ("copybench: method must be \"rw\", \"kernel\" "
+              "or \"none\"\n");
+      return EXIT_FAILURE;
+    }
+
+  /* Every byte of the source holds the low bits of its offset. */
+  src = create_open (SRC_NAME);
+  for (ofs = 0; ofs < size; ofs += CHUNK)
+    {
+      int n = size - ofs < CHUNK ? size - ofs : CHUNK;
+      int i;
+      for (i = 0; i < n; i++)
+        buf[i] = ofs + i;
+      if (write (src, buf, n) != n)
+        {
+          printf ("copybench: writing the source failed\n");
+          return EXIT_FAILURE;
+        }
+    }
+  dst = create_open (DST_NAME);
+
+  seek (src, 0);
+  if (!strcmp (method, "rw"))
+    {
+      int n;
+      while ((n = read (src, buf, CHUNK)) > 0)
+        {
+          if (write (dst, buf, n) != n)
+            break;
+          copied += n;
+        }
+    }
+  else if (!strcmp (method, "kernel"))
+    copied = copy_file_range (src, -1, dst, -1, size);
+
+  /* The baseline checks the source, which the copies match. */
+  check = strcmp (method, "none") ? dst : src;
+  if (check == dst && (copied != size || filesize (dst) != size))
+    {
+      printf ("copybench: copied %d of %d bytes\n", copied, size);
+      return EXIT_FAILURE;
+    }
+
+  seek (check, 0);
+  for (ofs = 0; ofs < size; ofs += CHUNK)
+    {
+      int n = read (check, buf, CHUNK);
+      int i;
+      for (i = 0; i < n; i++)
+        if (buf[i] != (char) (ofs + i))
+          {
+            printf ("copybench: byte %d of the copy is wrong\n", ofs + i);
+            return EXIT_FAILURE;
+          }
+    }
+  close (src);
+  close (dst);
+
+  if (check == src)
+    printf ("copybench: baseline of %d bytes, nothing copied\n", size);
+  else
+    printf ("copybench: copied %d bytes with %s\n", size,
+            !strcmp (method, "rw") ? "read/write" : "copy_file_range");
+  return EXIT_SUCCESS;
+}
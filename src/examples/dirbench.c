@@ -0,0 +1,74 @@
+/* dirbench.c
+
+   Directory benchmark.  Creates COUNT empty files in the root
+   directory, opens each of them by name in a scrambled order,
+   then removes them all, so that every phase is dominated by
+   directory lookups and inserts in a large directory.
+
+   User programs have no clock, so run it with "pintos -q" and
+   compare the tick counts and the buffer cache line printed at
+   shutdown.  Each file takes an inode sector, so give pintos a
+   file system disk of a few MB.
+
+   Usage: dirbench [COUNT] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+/* Default number of files. */
+#define DEFAULT_COUNT 2000
+
+/* Writes the name of file I into NAME. */
+static void
+file_name (char name[16], int i)
+{
+  snprintf (name, 16, "db%d", i);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int count = argc > 1 ? atoi (argv[1]) : DEFAULT_COUNT;
+  char name[16];
+  int i;
+
+  for (i = 0; i < count; i++)
+    {
+      file_name (name, i);
+      if (!create (name, 0))
+        {
+          printf ("dirbench: create %s failed\n", name);
+          return EXIT_FAILURE;
+        }
+    }
+
+  /* Step through the files with a prime stride, which visits
+     each once unless COUNT is a multiple of it. */
+  for (i = 0; i < count; i++)
+    {
+      int fd;
+
+      file_name (name, (int) ((i * 7919LL) % count));
+      fd = open (name);
+      if (fd < 0)
+        {
+          printf ("dirbench: open %s failed\n", name);
+          return EXIT_FAILURE;
+        }
+      close (fd);
+    }
+
+  for (i = 0; i < count; i++)
+    {
+      file_name (name, i);
+      if (!remove (name))
+        {
+          printf ("dirbench: remove %s failed\n", name);
+          return EXIT_FAILURE;
+        }
+    }
+
+  printf ("dirbench: created, opened and removed %d files\n", count);
+  return EXIT_SUCCESS;
+}
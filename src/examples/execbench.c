@@ -0,0 +1,42 @@
+/* execbench.c
+
+   Measures process startup by launching this program as a child
+   over and over, the way page-merge-par and multi-oom spawn
+   their children, and waiting for each one.
+
+   User programs have no clock, so run it with "pintos -q" and
+   compare the tick, page fault and prefetch counts printed at
+   shutdown against a run with the kernel's -no-prefetch option.
+
+   Usage: execbench [LAUNCHES] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Default number of child launches. */
+#define DEFAULT_LAUNCHES 50
+
+int
+main (int argc, char *argv[])
+{
+  int launches;
+  int i;
+
+  if (argc > 1 && !strcmp (argv[1], "child"))
+    return EXIT_SUCCESS;
+
+  launches = argc > 1 ? atoi (argv[1]) : DEFAULT_LAUNCHES;
+  for (i = 0; i < launches; i++)
+    {
+      pid_t pid = exec ("execbench child");
+      if (pid == PID_ERROR || wait (pid) != EXIT_SUCCESS)
+        {
+          printf ("execbench: launch %d failed\n", i);
+          return EXIT_FAILURE;
+        }
+    }
+  printf ("execbench: %d launches\n", launches);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,81 @@
+/* growbench.c
+
+   File growth benchmark.  Creates an empty file and grows it to
+   SIZE bytes with CHUNK-byte appends, the way a log or a download
+   grows, then checks the length.  The file is left behind for
+   seqbench to read.
+
+   User programs have no clock, so run it with "pintos -q" and
+   compare the tick counts and the buffer cache line printed at
+   shutdown.
+
+   Usage: growbench [SIZE [CHUNK]] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+/* Name of the file grown. */
+#define FILE_NAME "growbench.dat"
+
+/* Default file size and append size, in bytes. */
+#define DEFAULT_SIZE (1024 * 1024)
+#define DEFAULT_CHUNK 512
+
+/* Largest append size accepted. */
+#define MAX_CHUNK 4096
+
+int
+main (int argc, char *argv[])
+{
+  static char buf[MAX_CHUNK];
+  int size = argc > 1 ? atoi (argv[1]) : DEFAULT_SIZE;
+  int chunk = argc > 2 ? atoi (argv[2]) : DEFAULT_CHUNK;
+  int written;
+  int fd;
+
+  if (chunk <= 0 || chunk > MAX_CHUNK)
+    {
+      printf ("growbench: chunk must be between 1 and %d bytes\n", MAX_CHUNK);
+      return EXIT_FAILURE;
+    }
+
+  remove (FILE_NAME);
+  if (!create (FILE_NAME, 0))
+    {
+      printf ("growbench: create failed\n");
+      return EXIT_FAILURE;
+    }
+  fd = open (FILE_NAME);
+  if (fd < 0)
+    {
+      printf ("growbench: open failed\n");
+      return EXIT_FAILURE;
+    }
+
+  for (written = 0; written < size; written += chunk)
+    {
+      int n = size - written < chunk ? size - written : chunk;
+      int i;
+
+      /* Every byte holds the low bits of its offset. */
+      for (i = 0; i < n; i++)
+        buf[i] = written + i;
+      if (write (fd, buf, n) != n)
+        {
+          printf ("growbench: write at %d failed\n", written);
+          return EXIT_FAILURE;
+        }
+    }
+
+  if (filesize (fd) != size)
+    {
+      printf ("growbench: file is %d bytes, expected %d\n", filesize (fd), size);
+      return EXIT_FAILURE;
+    }
+  close (fd);
+
+  printf ("growbench: grew %s to %d bytes in %d-byte writes\n",
+          FILE_NAME, size, chunk);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+/* mallocbench.c
+
+   Allocation throughput benchmark for the user-level malloc().
+
+   Keeps a window of live blocks of random sizes, mostly small
+   with an occasional multi-page block, and replaces a random
+   one on every step.  Then grows a single buffer with realloc()
+   and frees everything, checking that the heap shrinks back.
+
+   User programs have no clock, so run it with "pintos -q" and
+   compare the user and kernel tick counts printed at shutdown.
+
+   Usage: mallocbench [ROUNDS] */
+
+#include <malloc.h>
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Number of blocks kept live at once. */
+#define WINDOW 512
+
+/* Default number of allocate/free steps. */
+#define DEFAULT_ROUNDS 100000
+
+/* Returns a random block size, usually under 256 bytes and
+   once in 64 times up to 16 kB. */
+static size_t
+random_size (void)
+{
+  unsigned long r = random_ulong ();
+  if (r % 64 == 0)
+    return 1 + (r >> 8) % (16 * 1024);
+  return 1 + (r >> 8) % 256;
+}
+
+int
+main (int argc, char *argv[])
+{
+  static char *live[WINDOW];
+  static size_t live_size[WINDOW];
+  int rounds = argc > 1 ? atoi (argv[1]) : DEFAULT_ROUNDS;
+  char *base = sbrk (0);
+  char *peak;
+  char *buf;
+  size_t size;
+  int i;
+
+  random_init (0);
+
+  for (i = 0; i < rounds; i++)
+    {
+      int slot = random_ulong () % WINDOW;
+      if (live[slot] != NULL)
+        {
+          if (live[slot][0] != (char) live_size[slot])
+            {
+              printf ("mallocbench: block %d corrupted\n", slot);
+              return EXIT_FAILURE;
+            }
+          free (live[slot]);
+        }
+      live_size[slot] = random_size ();
+      live[slot] = malloc (live_size[slot]);
+      if (live[slot] == NULL)
+        {
+          printf ("mallocbench: out of memory after %d rounds\n", i);
+          return EXIT_FAILURE;
+        }
+      live[slot][0] = (char) live_size[slot];
+    }
+  peak = sbrk (0);
+
+  /* Double a buffer up to 1 MB, as a growing array would. */
+  buf = NULL;
+  for (size = 16; size <= 1024 * 1024; size *= 2)
+    {
+      buf = realloc (buf, size);
+      if (buf == NULL)
+        {
+          printf ("mallocbench: realloc to %zu bytes failed\n", size);
+          return EXIT_FAILURE;
+        }
+      buf[size - 1] = 1;
+    }
+  free (buf);
+
+  for (i = 0; i < WINDOW; i++)
+    free (live[i]);
+
+  printf ("mallocbench: %d rounds, peak heap %d kB, %d kB left after free\n",
+          rounds, (int) (peak - base) / 1024, (int) ((char *) sbrk (0) - base) / 1024);
+  return EXIT_SUCCESS;
+}
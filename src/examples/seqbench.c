@@ -0,0 +1,72 @@
+/* seqbench.c
+
+   Sequential read benchmark.  Reads a file front to back in
+   CHUNK-byte reads, PASSES times, and checks the contents written
+   by growbench: every byte holds the low bits of its offset.
+
+   User programs have no clock, so run it with "pintos -q" and
+   compare the tick counts and the buffer cache line printed at
+   shutdown.
+
+   Usage: seqbench [FILE [CHUNK [PASSES]]] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+/* Default file, read size in bytes, and number of passes. */
+#define DEFAULT_FILE "growbench.dat"
+#define DEFAULT_CHUNK 512
+#define DEFAULT_PASSES 2
+
+/* Largest read size accepted. */
+#define MAX_CHUNK 4096
+
+int
+main (int argc, char *argv[])
+{
+  static char buf[MAX_CHUNK];
+  const char *name = argc > 1 ? argv[1] : DEFAULT_FILE;
+  int chunk = argc > 2 ? atoi (argv[2]) : DEFAULT_CHUNK;
+  int passes = argc > 3 ? atoi (argv[3]) : DEFAULT_PASSES;
+  int total = 0;
+  int pass;
+  int fd;
+
+  if (chunk <= 0 || chunk > MAX_CHUNK)
+    {
+      printf ("seqbench: chunk must be between 1 and %d bytes\n", MAX_CHUNK);
+      return EXIT_FAILURE;
+    }
+
+  fd = open (name);
+  if (fd < 0)
+    {
+      printf ("seqbench: cannot open %s, run growbench first\n", name);
+      return EXIT_FAILURE;
+    }
+
+  for (pass = 0; pass < passes; pass++)
+    {
+      int ofs = 0;
+      int n;
+
+      seek (fd, 0);
+      while ((n = read (fd, buf, chunk)) > 0)
+        {
+          int i;
+          for (i = 0; i < n; i++)
+            if (buf[i] != (char) (ofs + i))
+              {
+                printf ("seqbench: byte %d is wrong\n", ofs + i);
+                return EXIT_FAILURE;
+              }
+          ofs += n;
+        }
+      total += ofs;
+    }
+  close (fd);
+
+  printf ("seqbench: read %d bytes of %s in %d passes\n", total, name, passes);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+/* synbench.c
+
+   Concurrent file I/O benchmark, in the style of the syn-read and
+   syn-write tests.  Creates one file per process, then launches
+   PROCS copies of this program as children that each write their
+   own file and read it back PASSES times, and waits for all of
+   them.  With one lock for the whole file system the children
+   take turns; with per-inode locks they only meet at the disk.
+
+   User programs have no clock, so run it with "pintos -q" for a
+   few values of PROCS and compare the tick counts printed at
+   shutdown against the total bytes moved.
+
+   Usage: synbench [PROCS [PASSES]] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Default number of child processes and of read passes. */
+#define DEFAULT_PROCS 4
+#define DEFAULT_PASSES 4
+
+/* Most children launched at once. */
+#define MAX_PROCS 16
+
+/* Size of each child's file and of each read or write. */
+#define FILE_SIZE (64 * 1024)
+#define CHUNK 1024
+
+/* Writes the name of child ID's file into NAME. */
+static void
+file_name (char name[24], int id)
+{
+  snprintf (name, 24, "synbench.%d", id);
+}
+
+/* Runs child ID: fills its file, then reads it back PASSES times
+   and checks that every byte holds ID. */
+static int
+child (int id, int passes)
+{
+  static char buf[CHUNK];
+  char name[24];
+  int pass;
+  int fd;
+  int i;
+
+  file_name (name, id);
+  fd = open (name);
+  if (fd < 0)
+    {
+      printf ("synbench: child %d cannot open %s\n", id, name);
+      return EXIT_FAILURE;
+    }
+
+  memset (buf, id, sizeof buf);
+  for (i = 0; i < FILE_SIZE / CHUNK; i++)
+    if (write (fd, buf, CHUNK) != CHUNK)
+      {
+        printf ("synbench: child %d write failed\n", id);
+        return EXIT_FAILURE;
+      }
+
+  for (pass = 0; pass < passes; pass++)
+    {
+      seek (fd, 0);
+      for (i = 0; i < FILE_SIZE / CHUNK; i++)
+        {
+          int j;
+          if (read (fd, buf, CHUNK) != CHUNK)
+            {
+              printf ("synbench: child %d read failed\n", id);
+              return EXIT_FAILURE;
+            }
+          for (j = 0; j < CHUNK; j++)
+            if (buf[j] != (char) id)
+              {
+                printf ("synbench: child %d read wrong data\n", id);
+                return EXIT_FAILURE;
+              }
+        }
+    }
+  close (fd);
+  return EXIT_SUCCESS;
+}
+
+int
+main (int argc, char *argv[])
+{
+  pid_t children[MAX_PROCS];
+  int procs, passes;
+  int failed = 0;
+  int i;
+
+  if (argc > 3 && !strcmp (argv[1], "child"))
+    return child (atoi (argv[2]), atoi (argv[3]));
+
+  procs = argc > 1 ? atoi (argv[1]) : DEFAULT_PROCS;
+  passes = argc > 2 ? atoi (argv[2]) : DEFAULT_PASSES;
+  if (procs < 1 || procs > MAX_PROCS)
+    {
+      printf ("synbench: between 1 and %d processes\n", MAX_PROCS);
+      return EXIT_FAILURE;
+    }
+
+  for (i = 0; i < procs; i++)
+    {
+      char name[24];
+      file_name (name, i);
+      remove (name);
+      if (!create (name, 0))
+        {
+          printf ("synbench: cannot create %s\n", name);
+          return EXIT_FAILURE;
+        }
+    }
+
+  for (i = 0; i < procs; i++)
+    {
+      char cmd[64];
+      snprintf (cmd, sizeof cmd, "synbench child %d %d", i, passes);
+      children[i] = exec (cmd);
+      if (children[i] == PID_ERROR)
+        {
+          printf ("synbench: cannot launch child %d\n", i);
+          return EXIT_FAILURE;
+        }
+    }
+  for (i = 0; i < procs; i++)
+    if (wait (children[i]) != EXIT_SUCCESS)
+      failed++;
+
+  printf ("synbench: %d processes moved %d kB, %d failed\n",
+          procs, procs * (passes + 1) * FILE_SIZE / 1024, failed);
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,472 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* A cached sector.
+
+   The mapping from sectors to entries (SECTOR, PIN_CNT,
+   ACCESSED, EVICTING) is protected by cache_lock.  The contents
+   (DATA, VALID, DIRTY) are protected by the entry's own LOCK, so
+   I/O on one sector does not hold up lookups of others.  An
+   entry with a nonzero PIN_CNT is in use and is never evicted.
+   An EVICTING entry is being written back before it takes a new
+   sector, lookups of its old sector wait for evict_done. */
+struct cache_entry
+  {
+    block_sector_t sector;              /* Cached sector, if in use. */
+    bool in_use;                        /* False if the entry is free. */
+    int pin_cnt;                        /* Number of threads using it. */
+    bool accessed;                      /* Clock reference bit. */
+    bool evicting;                      /* Being written back for reuse. */
+
+    struct lock lock;                   /* Protects the fields below. */
+    bool valid;                         /* False until DATA is read. */
+    bool dirty;                         /* True if DATA is newer than disk. */
+    int64_t dirty_since;                /* Tick DIRTY was last set. */
+    uint8_t *data;                      /* BLOCK_SECTOR_SIZE bytes. */
+  };
+
+/* Milliseconds a sector may stay dirty before the flusher writes
+   it back.  0 disables the flusher, dirty sectors are then only
+   written on eviction and by cache_flush(). */
+int cache_flush_ms = 1000;
+
+static struct cache_entry cache[CACHE_SIZE];
+static struct lock cache_lock;
+static size_t clock_hand;
+
+/* Signaled under cache_lock when an eviction has written its
+   victim back. */
+static struct condition evict_done;
+
+/* Sectors waiting for the read-ahead thread.  Requests that do
+   not fit are dropped, read-ahead is only a hint. */
+#define READAHEAD_QUEUE 64
+static block_sector_t readahead_queue[READAHEAD_QUEUE];
+static size_t readahead_head, readahead_cnt;
+static struct lock readahead_lock;
+static struct condition readahead_cond;
+
+/* Statistics. */
+static long long hit_cnt, miss_cnt;
+static long long read_cnt, write_cnt;
+static long long readahead_read_cnt;
+static long long flush_write_cnt;
+
+static thread_func readahead_thread NO_RETURN;
+static thread_func flusher_thread NO_RETURN;
+
+/* Initializes the buffer cache. */
+void
+cache_init (void)
+{
+  size_t per_page = PGSIZE / BLOCK_SECTOR_SIZE;
+  size_t i;
+
+  lock_init (&cache_lock);
+  cond_init (&evict_done);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+      if (i % per_page == 0)
+        {
+          e->data = palloc_get_page (0);
+          if (e->data == NULL)
+            PANIC ("cache_init: out of memory");
+        }
+      else
+        e->data = cache[i - 1].data + BLOCK_SECTOR_SIZE;
+      lock_init (&e->lock);
+      e->in_use = false;
+      e->pin_cnt = 0;
+      e->evicting = false;
+    }
+
+  lock_init (&readahead_lock);
+  cond_init (&readahead_cond);
+  thread_create ("readahead", PRI_DEFAULT, readahead_thread, NULL);
+  if (cache_flush_ms > 0)
+    thread_create ("flusher", PRI_DEFAULT, flusher_thread, NULL);
+}
+
+/* Returns the entry that caches SECTOR, or a null pointer.
+   Must hold cache_lock. */
+static struct cache_entry *
+cache_lookup (block_sector_t sector)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].in_use && cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Writes E back to disk if it is dirty.  Must hold E's lock. */
+static void
+cache_write_back (struct cache_entry *e)
+{
+  if (e->valid && e->dirty)
+    {
+      block_write (fs_device, e->sector, e->data);
+      write_cnt++;
+      e->dirty = false;
+    }
+}
+
+/* Picks an entry to hold a new sector with the clock algorithm
+   and returns it with its lock held, its old contents possibly
+   still dirty.  Returns a null pointer if every entry is pinned
+   or being evicted.  Must hold cache_lock. */
+static struct cache_entry *
+cache_evict (void)
+{
+  size_t n;
+
+  /* Two sweeps: the first may only clear reference bits. */
+  for (n = 0; n < 2 * CACHE_SIZE; n++)
+    {
+      struct cache_entry *e = &cache[clock_hand];
+      clock_hand = (clock_hand + 1) % CACHE_SIZE;
+
+      if (!e->in_use)
+        {
+          lock_acquire (&e->lock);
+          return e;
+        }
+      if (e->pin_cnt > 0 || e->evicting)
+        continue;
+      if (e->accessed)
+        {
+          e->accessed = false;
+          continue;
+        }
+
+      /* Nobody holds the lock of an unpinned entry that is not
+         being evicted, so this does not block. */
+      lock_acquire (&e->lock);
+      return e;
+    }
+  return NULL;
+}
+
+/* Takes an entry to hold SECTOR, which is not cached, and
+   returns it with its lock held, ready to be read into.  A dirty
+   victim is written back with only its own lock held: it is
+   marked evicting meanwhile, so lookups of its sector wait
+   instead of reading the sector from disk before it is written.
+   Returns a null pointer if every entry is in use or if another
+   thread cached SECTOR during the write-back.  Must hold
+   cache_lock, which is released around the write-back. */
+static struct cache_entry *
+cache_replace (block_sector_t sector)
+{
+  struct cache_entry *e = cache_evict ();
+
+  if (e == NULL)
+    return NULL;
+  if (e->in_use && e->valid && e->dirty)
+    {
+      e->evicting = true;
+      lock_release (&cache_lock);
+      cache_write_back (e);
+      lock_acquire (&cache_lock);
+      e->evicting = false;
+      cond_broadcast (&evict_done, &cache_lock);
+      if (cache_lookup (sector) != NULL)
+        {
+          lock_release (&e->lock);
+          return NULL;
+        }
+    }
+  e->sector = sector;
+  e->in_use = true;
+  e->valid = false;
+  e->dirty = false;
+  return e;
+}
+
+/* Returns the entry for SECTOR with its lock held, reading the
+   sector from disk unless FULL_WRITE says the caller is about to
+   overwrite all of it. */
+static struct cache_entry *
+cache_get (block_sector_t sector, bool full_write)
+{
+  struct cache_entry *e;
+  bool locked = false;
+
+  lock_acquire (&cache_lock);
+  for (;;)
+    {
+      e = cache_lookup (sector);
+      if (e != NULL && e->evicting)
+        {
+          /* Its old contents are on their way to disk. */
+          cond_wait (&evict_done, &cache_lock);
+          continue;
+        }
+      if (e != NULL)
+        {
+          hit_cnt++;
+          break;
+        }
+      e = cache_replace (sector);
+      if (e != NULL)
+        {
+          miss_cnt++;
+          locked = true;
+          break;
+        }
+      if (cache_lookup (sector) != NULL)
+        continue;
+
+      /* Every entry is in use, wait for one to be released. */
+      lock_release (&cache_lock);
+      thread_yield ();
+      lock_acquire (&cache_lock);
+    }
+  e->pin_cnt++;
+  e->accessed = true;
+  lock_release (&cache_lock);
+
+  if (!locked)
+    lock_acquire (&e->lock);
+  if (!e->valid && !full_write)
+    {
+      block_read (fs_device, sector, e->data);
+      read_cnt++;
+      e->valid = true;
+    }
+  return e;
+}
+
+/* Releases an entry returned by cache_get(). */
+static void
+cache_put (struct cache_entry *e)
+{
+  lock_release (&e->lock);
+  lock_acquire (&cache_lock);
+  e->pin_cnt--;
+  lock_release (&cache_lock);
+}
+
+/* Reads SIZE bytes starting at offset OFS within SECTOR into
+   BUFFER.  BUFFER must be kernel memory: the entry stays locked
+   during the copy, and a page fault could need it again. */
+void
+cache_read (block_sector_t sector, void *buffer, size_t ofs, size_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+  e = cache_get (sector, false);
+  memcpy (buffer, e->data + ofs, size);
+  cache_put (e);
+}
+
+/* Writes SIZE bytes from BUFFER to offset OFS within SECTOR.
+   The sector reaches the disk when it is evicted or flushed.
+   BUFFER must be kernel memory, as for cache_read(). */
+void
+cache_write (block_sector_t sector, const void *buffer, size_t ofs,
+             size_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+  e = cache_get (sector, size == BLOCK_SECTOR_SIZE);
+  memcpy (e->data + ofs, buffer, size);
+  e->valid = true;
+  if (!e->dirty)
+    {
+      e->dirty = true;
+      e->dirty_since = timer_ticks ();
+    }
+  cache_put (e);
+}
+
+/* Queues SECTOR to be read into the cache in the background. */
+void
+cache_readahead (block_sector_t sector)
+{
+  lock_acquire (&readahead_lock);
+  if (readahead_cnt < READAHEAD_QUEUE)
+    {
+      readahead_queue[(readahead_head + readahead_cnt++) % READAHEAD_QUEUE]
+        = sector;
+      cond_signal (&readahead_cond, &readahead_lock);
+    }
+  lock_release (&readahead_lock);
+}
+
+/* Reads SECTOR into the cache unless it is there already.  A
+   reader that wants it meanwhile finds the entry and waits on
+   its lock until the read is done. */
+static void
+cache_prefetch (block_sector_t sector)
+{
+  struct cache_entry *e;
+
+  lock_acquire (&cache_lock);
+  if (cache_lookup (sector) != NULL || (e = cache_replace (sector)) == NULL)
+    {
+      lock_release (&cache_lock);
+      return;
+    }
+  e->pin_cnt++;
+  e->accessed = true;
+  lock_release (&cache_lock);
+
+  block_read (fs_device, sector, e->data);
+  read_cnt++;
+  readahead_read_cnt++;
+  e->valid = true;
+  cache_put (e);
+}
+
+/* The read-ahead thread, serves queued sectors in order. */
+static void
+readahead_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      block_sector_t sector;
+
+      lock_acquire (&readahead_lock);
+      while (readahead_cnt == 0)
+        cond_wait (&readahead_cond, &readahead_lock);
+      sector = readahead_queue[readahead_head];
+      readahead_head = (readahead_head + 1) % READAHEAD_QUEUE;
+      readahead_cnt--;
+      lock_release (&readahead_lock);
+
+      cache_prefetch (sector);
+    }
+}
+
+/* Returns true if one of the CNT sectors at FIRST is being
+   evicted.  Must hold cache_lock. */
+static bool
+cache_evicting (block_sector_t first, size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].evicting && cache[i].sector >= first
+        && cache[i].sector - first < cnt)
+      return true;
+  return false;
+}
+
+/* Writes back the sectors among the CNT sectors at FIRST that
+   have been dirty since tick BEFORE or earlier, along with any
+   dirty sectors of the range next to them on disk, in ascending
+   sector order so that runs of sectors are written back to
+   back. */
+static void
+cache_write_behind (int64_t before, block_sector_t first, size_t cnt)
+{
+  struct cache_entry *batch[CACHE_SIZE];
+  bool expired[CACHE_SIZE];
+  size_t n = 0;
+  size_t i, j;
+
+  /* Let evictions in the range finish writing first, they are
+     skipped below.  Then collect the dirty entries sorted by
+     sector and pin them, so they stay put while we write them
+     without cache_lock. */
+  lock_acquire (&cache_lock);
+  while (cache_evicting (first, cnt))
+    cond_wait (&evict_done, &cache_lock);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+      if (!e->in_use || !e->dirty
+          || e->sector < first || e->sector - first >= cnt)
+        continue;
+      for (j = n; j > 0 && batch[j - 1]->sector > e->sector; j--)
+        {
+          batch[j] = batch[j - 1];
+          expired[j] = expired[j - 1];
+        }
+      batch[j] = e;
+      expired[j] = e->dirty_since <= before;
+      e->pin_cnt++;
+      n++;
+    }
+  lock_release (&cache_lock);
+
+  /* Extend every expired sector to the run of dirty sectors
+     around it. */
+  for (i = 1; i < n; i++)
+    if (expired[i - 1] && batch[i - 1]->sector + 1 == batch[i]->sector)
+      expired[i] = true;
+  for (i = n; i-- > 1; )
+    if (expired[i] && batch[i - 1]->sector + 1 == batch[i]->sector)
+      expired[i - 1] = true;
+
+  for (i = 0; i < n; i++)
+    {
+      struct cache_entry *e = batch[i];
+      lock_acquire (&e->lock);
+      if (expired[i] && e->dirty)
+        {
+          cache_write_back (e);
+          flush_write_cnt++;
+        }
+      cache_put (e);
+    }
+}
+
+/* The flusher thread, writes back sectors that have been dirty
+   for longer than cache_flush_ms.  The free map's pending changes
+   are put in the cache first so they go out with them. */
+static void
+flusher_thread (void *aux UNUSED)
+{
+  int64_t age = (int64_t) cache_flush_ms * TIMER_FREQ / 1000;
+  int64_t period = age / 2 > 0 ? age / 2 : 1;
+
+  for (;;)
+    {
+      timer_sleep (period);
+      free_map_flush ();
+      cache_write_behind (timer_ticks () - age, 0, SIZE_MAX);
+    }
+}
+
+/* Writes every dirty sector back to disk now. */
+void
+cache_flush (void)
+{
+  cache_write_behind (INT64_MAX, 0, SIZE_MAX);
+}
+
+/* Writes the dirty sectors among the CNT sectors at FIRST back to
+   disk now. */
+void
+cache_flush_range (block_sector_t first, size_t cnt)
+{
+  cache_write_behind (INT64_MAX, first, cnt);
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void)
+{
+  long long lookups = hit_cnt + miss_cnt;
+
+  printf ("Buffer cache: %lld hits, %lld misses (%lld%% hit ratio), "
+          "%lld sectors read (%lld ahead), %lld written (%lld behind)\n",
+          hit_cnt, miss_cnt, lookups > 0 ? hit_cnt * 100 / lookups : 0,
+          read_cnt, readahead_read_cnt, write_cnt, flush_write_cnt);
+}
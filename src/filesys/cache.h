@@ -0,0 +1,20 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Number of sectors kept in the buffer cache. */
+#define CACHE_SIZE 64
+
+extern int cache_flush_ms;
+
+void cache_init (void);
+void cache_read (block_sector_t, void *, size_t ofs, size_t size);
+void cache_write (block_sector_t, const void *, size_t ofs, size_t size);
+void cache_readahead (block_sector_t);
+void cache_flush (void);
+void cache_flush_range (block_sector_t first, size_t cnt);
+void cache_print_stats (void);
+
+#endif /* filesys/cache.h */
@@ -0,0 +1,179 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* A cached name: the file NAME in the directory whose inode is
+   at DIR has its inode at SECTOR, or does not exist if SECTOR is
+   DCACHE_NONE.
+
+   The directory code keeps the cache up to date.  It fills in
+   names it looked up and rewrites them whenever it adds or
+   removes a name, all under its own lock, so a cached answer is
+   always the answer the disk would give. */
+struct dcache_entry
+  {
+    block_sector_t dir;                 /* Directory inode sector. */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+    block_sector_t sector;              /* Inode sector or DCACHE_NONE. */
+    struct hash_elem elem;              /* Element in names. */
+    struct list_elem lru_elem;          /* Element in lru. */
+  };
+
+/* Cached names, and the same names least recently used first. */
+static struct hash names;
+static struct list lru;
+
+/* Protects names and lru.  The directory lock is held shared by
+   lookups, which fill in the cache too. */
+static struct lock dcache_lock;
+
+/* Statistics. */
+static long long hit_cnt, negative_hit_cnt, miss_cnt;
+
+static unsigned
+dcache_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dcache_entry *d = hash_entry (e, struct dcache_entry, elem);
+  return hash_string (d->name) ^ hash_int (d->dir);
+}
+
+static bool
+dcache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dcache_entry *a = hash_entry (a_, struct dcache_entry, elem);
+  const struct dcache_entry *b = hash_entry (b_, struct dcache_entry, elem);
+  if (a->dir != b->dir)
+    return a->dir < b->dir;
+  return strcmp (a->name, b->name) < 0;
+}
+
+/* Initializes the name lookup cache. */
+void
+dcache_init (void)
+{
+  hash_init (&names, dcache_hash, dcache_less, NULL);
+  list_init (&lru);
+  lock_init (&dcache_lock);
+}
+
+/* Returns the entry for NAME in DIR, or a null pointer if there
+   is none.  Must hold dcache_lock. */
+static struct dcache_entry *
+find (block_sector_t dir, const char *name)
+{
+  struct dcache_entry key;
+  struct hash_elem *e;
+
+  key.dir = dir;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&names, &key.elem);
+  return e != NULL ? hash_entry (e, struct dcache_entry, elem) : NULL;
+}
+
+/* Looks up NAME in the directory whose inode is at DIR.  If the
+   answer is cached, sets *SECTORP to the file's inode sector, or
+   to DCACHE_NONE if it is known not to exist, and returns true.
+   Returns false if the directory has to be read. */
+bool
+dcache_lookup (block_sector_t dir, const char *name,
+               block_sector_t *sectorp)
+{
+  struct dcache_entry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return false;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d != NULL)
+    {
+      list_remove (&d->lru_elem);
+      list_push_back (&lru, &d->lru_elem);
+      *sectorp = d->sector;
+      if (d->sector == DCACHE_NONE)
+        negative_hit_cnt++;
+      else
+        hit_cnt++;
+    }
+  else
+    miss_cnt++;
+  lock_release (&dcache_lock);
+
+  return d != NULL;
+}
+
+/* Records that NAME in the directory whose inode is at DIR has
+   its inode at SECTOR, or does not exist if SECTOR is
+   DCACHE_NONE.  Reuses the least recently used entry once the
+   cache is full. */
+void
+dcache_insert (block_sector_t dir, const char *name, block_sector_t sector)
+{
+  struct dcache_entry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d != NULL)
+    list_remove (&d->lru_elem);
+  else
+    {
+      if (hash_size (&names) < DCACHE_SIZE)
+        d = malloc (sizeof *d);
+      if (d == NULL)
+        {
+          if (list_empty (&lru))
+            {
+              lock_release (&dcache_lock);
+              return;
+            }
+          d = list_entry (list_pop_front (&lru), struct dcache_entry,
+                          lru_elem);
+          hash_delete (&names, &d->elem);
+        }
+      d->dir = dir;
+      strlcpy (d->name, name, sizeof d->name);
+      hash_insert (&names, &d->elem);
+    }
+  d->sector = sector;
+  list_push_back (&lru, &d->lru_elem);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets whatever is cached for NAME in the directory whose
+   inode is at DIR. */
+void
+dcache_invalidate (block_sector_t dir, const char *name)
+{
+  struct dcache_entry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d != NULL)
+    {
+      hash_delete (&names, &d->elem);
+      list_remove (&d->lru_elem);
+      free (d);
+    }
+  lock_release (&dcache_lock);
+}
+
+/* Prints name lookup cache statistics. */
+void
+dcache_print_stats (void)
+{
+  printf ("Name cache: %lld hits, %lld negative hits, %lld misses\n",
+          hit_cnt, negative_hit_cnt, miss_cnt);
+}
@@ -1,10 +1,14 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include <round.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir 
@@ -21,12 +25,48 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* A directory is a hash table of buckets, one sector each.  The
+   number of buckets is a power of two and a name lives in the
+   bucket selected by the low bits of its hash, so lookup, insert
+   and delete read a single sector however big the directory is.
+   A bucket that overflows doubles the table, which moves each
+   entry of bucket I either nowhere or to bucket I + old size. */
+#define BUCKET_ENTRIES (BLOCK_SECTOR_SIZE / sizeof (struct dir_entry))
+
+/* Most buckets a directory grows to. */
+#define MAX_BUCKETS 4096
+
+/* A hash bucket.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct dir_bucket
+  {
+    struct dir_entry entries[BUCKET_ENTRIES];
+    uint8_t unused[BLOCK_SECTOR_SIZE
+                   - BUCKET_ENTRIES * sizeof (struct dir_entry)];
+  };
+
+/* Lookups and listings of any directory run in parallel; adding
+   or removing an entry, which may split buckets, excludes them. */
+static struct rwlock dir_rw;
+
+/* Initializes the directory module. */
+void
+dir_init (void)
+{
+  rwlock_init (&dir_rw);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (block_sector_t sector, size_t entry_cnt)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  size_t bucket_cnt = 1;
+
+  ASSERT (sizeof (struct dir_bucket) == BLOCK_SECTOR_SIZE);
+  while (bucket_cnt * BUCKET_ENTRIES < entry_cnt && bucket_cnt < MAX_BUCKETS)
+    bucket_cnt *= 2;
+  return inode_create (sector, bucket_cnt * BLOCK_SECTOR_SIZE);
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -83,32 +123,148 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
+/* Returns the number of buckets in DIR: the largest power of two
+   that fits in its length, since a split that ran out of disk
+   space may have left a partial table behind the last bucket. */
+static size_t
+bucket_cnt (const struct dir *dir)
+{
+  size_t sectors = inode_length (dir->inode) / BLOCK_SECTOR_SIZE;
+  size_t n = 1;
+
+  if (sectors == 0)
+    return 0;
+  while (n * 2 <= sectors)
+    n *= 2;
+  return n;
+}
+
+/* Returns the byte offset of entry SLOT of bucket IDX. */
+static off_t
+entry_ofs (size_t idx, size_t slot)
+{
+  return idx * BLOCK_SECTOR_SIZE + slot * sizeof (struct dir_entry);
+}
+
+/* Reads bucket IDX of DIR into *B.  Returns false on a short read. */
+static bool
+read_bucket (const struct dir *dir, size_t idx, struct dir_bucket *b)
+{
+  return inode_read_at (dir->inode, b, sizeof *b,
+                        idx * BLOCK_SECTOR_SIZE) == sizeof *b;
+}
+
+/* Writes *B as bucket IDX of DIR.  Returns false on a short write. */
+static bool
+write_bucket (struct dir *dir, size_t idx, const struct dir_bucket *b)
+{
+  return inode_write_at (dir->inode, b, sizeof *b,
+                         idx * BLOCK_SECTOR_SIZE) == sizeof *b;
+}
+
 /* Searches DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
+   otherwise, returns false and ignores EP and OFSP.
+   If ABSENTP is non-null, sets *ABSENTP to true if NAME is
+   known not to be in DIR and to false if a disk or memory error
+   left the question open. */
 static bool
 lookup (const struct dir *dir, const char *name,
-        struct dir_entry *ep, off_t *ofsp) 
+        struct dir_entry *ep, off_t *ofsp, bool *absentp) 
 {
-  struct dir_entry e;
-  size_t ofs;
+  struct dir_bucket *b;
+  size_t n, idx, slot;
+  bool found = false;
+  bool absent = false;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (e.in_use && !strcmp (name, e.name)) 
-      {
-        if (ep != NULL)
-          *ep = e;
-        if (ofsp != NULL)
-          *ofsp = ofs;
-        return true;
-      }
-  return false;
+  n = bucket_cnt (dir);
+  if (n == 0)
+    absent = true;
+  else if ((b = malloc (sizeof *b)) != NULL)
+    {
+      idx = hash_string (name) & (n - 1);
+      if (read_bucket (dir, idx, b))
+        {
+          absent = true;
+          for (slot = 0; slot < BUCKET_ENTRIES; slot++)
+            {
+              struct dir_entry *e = &b->entries[slot];
+              if (e->in_use && !strcmp (name, e->name))
+                {
+                  if (ep != NULL)
+                    *ep = *e;
+                  if (ofsp != NULL)
+                    *ofsp = entry_ofs (idx, slot);
+                  found = true;
+                  absent = false;
+                  break;
+                }
+            }
+        }
+      free (b);
+    }
+  if (absentp != NULL)
+    *absentp = absent;
+  return found;
+}
+
+/* Doubles the number of buckets of DIR, splitting each bucket
+   between itself and its new twin.  Returns false if DIR is
+   already as big as it may grow or a disk or memory error
+   occurs. */
+static bool
+split_buckets (struct dir *dir)
+{
+  struct dir_bucket *b, *lo, *hi;
+  size_t n = bucket_cnt (dir);
+  size_t idx, slot;
+  bool success = false;
+
+  if (n == 0 || n * 2 > MAX_BUCKETS)
+    return false;
+  b = malloc (3 * sizeof *b);
+  if (b == NULL)
+    return false;
+  lo = b + 1;
+  hi = b + 2;
+
+  /* Grow the directory to its new size before moving anything,
+     so running out of space leaves the old table intact. */
+  memset (hi, 0, sizeof *hi);
+  if (!write_bucket (dir, 2 * n - 1, hi))
+    goto done;
+
+  for (idx = 0; idx < n; idx++)
+    {
+      size_t lo_cnt = 0, hi_cnt = 0;
+
+      if (!read_bucket (dir, idx, b))
+        goto done;
+      memset (lo, 0, sizeof *lo);
+      memset (hi, 0, sizeof *hi);
+      for (slot = 0; slot < BUCKET_ENTRIES; slot++)
+        {
+          struct dir_entry *e = &b->entries[slot];
+          if (!e->in_use)
+            continue;
+          if (hash_string (e->name) & n)
+            hi->entries[hi_cnt++] = *e;
+          else
+            lo->entries[lo_cnt++] = *e;
+        }
+      if (!write_bucket (dir, idx + n, hi) || !write_bucket (dir, idx, lo))
+        goto done;
+    }
+  success = true;
+
+ done:
+  free (b);
+  return success;
 }
 
 /* Searches DIR for a file with the given NAME
@@ -119,15 +275,26 @@ bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
+  block_sector_t dir_sector, sector = DCACHE_NONE;
   struct dir_entry e;
+  bool absent;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
-  else
-    *inode = NULL;
+  dir_sector = inode_get_inumber (dir->inode);
+  rwlock_acquire_read (&dir_rw);
+  if (!dcache_lookup (dir_sector, name, &sector))
+    {
+      /* Remember the answer, including that NAME does not exist,
+         unless an error kept us from finding out. */
+      if (lookup (dir, name, &e, NULL, &absent))
+        sector = e.inode_sector;
+      if (sector != DCACHE_NONE || absent)
+        dcache_insert (dir_sector, name, sector);
+    }
+  *inode = sector != DCACHE_NONE ? inode_open (sector) : NULL;
+  rwlock_release_read (&dir_rw);
 
   return *inode != NULL;
 }
@@ -141,6 +308,7 @@ dir_lookup (const struct dir *dir, const char *name,
 bool
 dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 {
+  block_sector_t dir_sector, cached;
   struct dir_entry e;
   off_t ofs;
   bool success = false;
@@ -152,29 +320,59 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
+  dir_sector = inode_get_inumber (dir->inode);
+  rwlock_acquire_write (&dir_rw);
+
   /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  if (dcache_lookup (dir_sector, name, &cached))
+    {
+      if (cached != DCACHE_NONE)
+        goto done;
+    }
+  else if (lookup (dir, name, NULL, NULL, NULL))
     goto done;
 
-  /* Set OFS to offset of free slot.
-     If there are no free slots, then it will be set to the
-     current end-of-file.
-     
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
+  /* A directory created empty gets its first bucket now. */
+  if (bucket_cnt (dir) == 0)
+    {
+      static struct dir_bucket empty;
+      if (!write_bucket (dir, 0, &empty))
+        goto done;
+    }
+
+  /* Take a free slot in NAME's bucket, doubling the number of
+     buckets until there is one. */
+  for (;;)
+    {
+      size_t idx = hash_string (name) & (bucket_cnt (dir) - 1);
+      size_t slot;
+
+      for (slot = 0; slot < BUCKET_ENTRIES; slot++)
+        {
+          ofs = entry_ofs (idx, slot);
+          if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+            goto done;
+          if (!e.in_use)
+            break;
+        }
+      if (slot < BUCKET_ENTRIES)
+        break;
+      if (!split_buckets (dir))
+        goto done;
+    }
 
   /* Write slot. */
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  if (success)
+    dcache_insert (dir_sector, name, inode_sector);
+  else
+    dcache_invalidate (dir_sector, name);
 
  done:
+  rwlock_release_write (&dir_rw);
   return success;
 }
 
@@ -192,8 +390,10 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  rwlock_acquire_write (&dir_rw);
+
   /* Find directory entry. */
-  if (!lookup (dir, name, &e, &ofs))
+  if (!lookup (dir, name, &e, &ofs, NULL))
     goto done;
 
   /* Open inode. */
@@ -204,33 +404,47 @@ dir_remove (struct dir *dir, const char *name)
   /* Erase directory entry. */
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
-    goto done;
+    {
+      dcache_invalidate (inode_get_inumber (dir->inode), name);
+      goto done;
+    }
+  dcache_insert (inode_get_inumber (dir->inode), name, DCACHE_NONE);
 
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
  done:
+  rwlock_release_write (&dir_rw);
   inode_close (inode);
   return success;
 }
 
 /* Reads the next directory entry in DIR and stores the name in
    NAME.  Returns true if successful, false if the directory
-   contains no more entries. */
+   contains no more entries.  Entries come in bucket order. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  bool found = false;
 
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  rwlock_acquire_read (&dir_rw);
+  while (!found)
     {
+      /* Skip the unused tail of each bucket. */
+      if (dir->pos % BLOCK_SECTOR_SIZE
+          > (off_t) ((BUCKET_ENTRIES - 1) * sizeof e))
+        dir->pos = ROUND_UP (dir->pos, BLOCK_SECTOR_SIZE);
+      if (inode_read_at (dir->inode, &e, sizeof e, dir->pos) != sizeof e)
+        break;
       dir->pos += sizeof e;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          found = true;
         } 
     }
-  return false;
+  rwlock_release_read (&dir_rw);
+  return found;
 }
@@ -1,8 +1,13 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include "devices/block.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
 
+/* Bounds of the read-ahead window, in bytes. */
+#define READAHEAD_MIN (4 * BLOCK_SECTOR_SIZE)
+#define READAHEAD_MAX (32 * BLOCK_SECTOR_SIZE)
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
@@ -15,6 +20,9 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ra_next = 0;
+      file->ra_window = 0;
+      file->ra_end = 0;
       return file;
     }
   else
@@ -52,6 +60,42 @@ file_get_inode (struct file *file)
   return file->inode;
 }
 
+/* Called before a read of SIZE bytes at FILE's current position,
+   by file_read() and by the page cache's reads.
+   A read that starts where the previous one ended is sequential:
+   the read-ahead window doubles, up to READAHEAD_MAX, and the
+   bytes past the read that are not read ahead yet are queued for
+   the buffer cache.  Any other read collapses the window. */
+void
+file_readahead (struct file *file, off_t size)
+{
+  off_t start, end;
+  bool sequential = file->pos == file->ra_next;
+
+  file->ra_next = file->pos + size;
+  if (!sequential)
+    {
+      file->ra_window = 0;
+      file->ra_end = 0;
+      return;
+    }
+
+  if (file->ra_window == 0)
+    file->ra_window = READAHEAD_MIN;
+  else if (file->ra_window < READAHEAD_MAX)
+    file->ra_window *= 2;
+
+  start = file->pos + size;
+  if (start < file->ra_end)
+    start = file->ra_end;
+  end = file->pos + size + file->ra_window;
+  if (start < end)
+    {
+      inode_readahead (file->inode, start, end - start);
+      file->ra_end = end;
+    }
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
    starting at the file's current position.
    Returns the number of bytes actually read,
@@ -60,7 +104,10 @@ file_get_inode (struct file *file)
 off_t
 file_read (struct file *file, void *buffer, off_t size)
 {
-  off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  off_t bytes_read;
+
+  file_readahead (file, size);
+  bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -79,9 +126,8 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk fills up.
+   Writing past end of file grows the file.
    Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size)
@@ -94,9 +140,8 @@ file_write (struct file *file, const void *buffer, off_t size)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk fills up.
+   Writing past end of file grows the file.
    The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
@@ -12,6 +12,9 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    off_t ra_next;              /* Position a sequential read starts at. */
+    off_t ra_window;            /* Read-ahead window, 0 if not sequential. */
+    off_t ra_end;               /* End of the bytes already read ahead. */
   };
 
 /* Opening and closing files. */
@@ -22,6 +25,7 @@ struct inode *file_get_inode (struct file *);
 
 /* Reading and writing. */
 off_t file_read (struct file *, void *, off_t);
+void file_readahead (struct file *, off_t size);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
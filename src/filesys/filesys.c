@@ -2,6 +2,8 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
@@ -21,7 +23,10 @@ filesys_init (bool format)
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
+  cache_init ();
   inode_init ();
+  dir_init ();
+  dcache_init ();
   free_map_init ();
 
   if (format) 
@@ -36,8 +41,37 @@ void
 filesys_done (void) 
 {
   free_map_close ();
+  cache_flush ();
+  cache_print_stats ();
+  dcache_print_stats ();
 }
 
+/* Makes the data of FILE and the metadata needed to find it
+   durable, without writing anything else in the buffer cache.
+   The data goes first, then the free map sectors that record its
+   allocation, then the inode, so a crash in between loses at
+   worst free sectors, never points the inode at sectors another
+   file may get.  The device writes its own cache out last. */
+void
+filesys_fsync (struct file *file)
+{
+  struct inode *inode = file_get_inode (file);
+
+  inode_flush_data (inode);
+  free_map_sync ();
+  inode_flush (inode);
+  block_flush (fs_device);
+}
+
+/* Writes every dirty sector of the file system to disk. */
+void
+filesys_sync (void)
+{
+  free_map_flush ();
+  cache_flush ();
+  block_flush (fs_device);
+}
+
 /* Creates a file named NAME with the given INITIAL_SIZE.
    Returns true if successful, false otherwise.
    Fails if a file named NAME already exists,
@@ -48,7 +82,8 @@ filesys_create (const char *name, off_t initial_size)
   block_sector_t inode_sector = 0;
   struct dir *dir = dir_open_root ();
   bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
+                  /* Put the inode near its directory's. */
+                  && free_map_allocate (1, ROOT_DIR_SECTOR, &inode_sector)
                   && inode_create (inode_sector, initial_size)
                   && dir_add (dir, name, inode_sector));
   if (!success && inode_sector != 0) 
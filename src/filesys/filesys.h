@@ -16,5 +16,7 @@ void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
 struct file *filesys_open (const char *name);
 bool filesys_remove (const char *name);
+void filesys_fsync (struct file *);
+void filesys_sync (void);
 
 #endif /* filesys/filesys.h */
@@ -1,13 +1,199 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
+#include <string.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
 
+/* Sectors of the free map file that are out of date, one bit per
+   sector.  Allocations only mark them, free_map_flush() writes
+   them out together. */
+static struct bitmap *dirty_map;
+
+/* A run of free sectors. */
+struct free_run
+  {
+    block_sector_t start;           /* First free sector. */
+    block_sector_t length;          /* Number of free sectors. */
+  };
+
+/* Index of the free sectors as runs sorted by position, kept in
+   step with free_map.  A binary search finds the runs around a
+   hint sector, so allocation looks at a few runs close to where
+   the data should go instead of scanning the bitmap from the
+   start of the disk. */
+static struct free_run *runs;
+static size_t run_cnt;              /* Runs in use. */
+static size_t run_cap;              /* Runs allocated. */
+
+/* Runs on each side of the hint looked at for a best fit before
+   falling back to the best fit on the whole disk. */
+#define NEAR_RUNS 8
+
+/* Protects free_map, dirty_map and the run index. */
+static struct lock free_map_lock;
+
+/* Bits of the free map stored in one sector of its file. */
+#define BITS_PER_SECTOR (BLOCK_SECTOR_SIZE * 8)
+
+static void mark_dirty (block_sector_t, size_t);
+
+/* Inserts a run of LENGTH sectors at START as run IDX. */
+static void
+run_insert (size_t idx, block_sector_t start, block_sector_t length)
+{
+  if (run_cnt == run_cap)
+    {
+      size_t cap = run_cap > 0 ? run_cap * 2 : 64;
+      struct free_run *new_runs = realloc (runs, cap * sizeof *runs);
+      if (new_runs == NULL)
+        PANIC ("free map index out of memory");
+      runs = new_runs;
+      run_cap = cap;
+    }
+  memmove (runs + idx + 1, runs + idx, (run_cnt - idx) * sizeof *runs);
+  runs[idx].start = start;
+  runs[idx].length = length;
+  run_cnt++;
+}
+
+/* Deletes run IDX. */
+static void
+run_delete (size_t idx)
+{
+  run_cnt--;
+  memmove (runs + idx, runs + idx + 1, (run_cnt - idx) * sizeof *runs);
+}
+
+/* Returns the index of the first run that starts after SECTOR. */
+static size_t
+run_after (block_sector_t sector)
+{
+  size_t lo = 0, hi = run_cnt;
+
+  while (lo < hi)
+    {
+      size_t mid = (lo + hi) / 2;
+      if (runs[mid].start <= sector)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  return lo;
+}
+
+/* Removes the CNT sectors at SECTOR, which must all lie in run
+   IDX, from the index. */
+static void
+run_take (size_t idx, block_sector_t sector, size_t cnt)
+{
+  struct free_run *r = &runs[idx];
+  block_sector_t end = r->start + r->length;
+
+  ASSERT (sector >= r->start && sector + cnt <= end);
+  if (sector == r->start && cnt == r->length)
+    run_delete (idx);
+  else if (sector == r->start)
+    {
+      r->start += cnt;
+      r->length -= cnt;
+    }
+  else
+    {
+      r->length = sector - r->start;
+      if (sector + cnt < end)
+        run_insert (idx + 1, sector + cnt, end - (sector + cnt));
+    }
+}
+
+/* Adds the CNT sectors at SECTOR to the index, merging them with
+   the runs on either side. */
+static void
+run_give (block_sector_t sector, size_t cnt)
+{
+  size_t idx = run_after (sector);
+  bool merge_prev = idx > 0
+                    && runs[idx - 1].start + runs[idx - 1].length == sector;
+  bool merge_next = idx < run_cnt && sector + cnt == runs[idx].start;
+
+  if (merge_prev && merge_next)
+    {
+      runs[idx - 1].length += cnt + runs[idx].length;
+      run_delete (idx);
+    }
+  else if (merge_prev)
+    runs[idx - 1].length += cnt;
+  else if (merge_next)
+    {
+      runs[idx].start = sector;
+      runs[idx].length += cnt;
+    }
+  else
+    run_insert (idx, sector, cnt);
+}
+
+/* Rebuilds the run index from free_map. */
+static void
+index_build (void)
+{
+  size_t size = bitmap_size (free_map);
+  size_t start = 0;
+
+  run_cnt = 0;
+  while (start < size
+         && (start = bitmap_scan (free_map, start, 1, false)) != BITMAP_ERROR)
+    {
+      size_t end = start + 1;
+      while (end < size && !bitmap_test (free_map, end))
+        end++;
+      run_insert (run_cnt, start, end - start);
+      start = end;
+    }
+}
+
+/* Returns the index of the run to take CNT sectors from for data
+   that should go near HINT: the smallest run that fits among the
+   NEAR_RUNS runs on each side of HINT, else the smallest run that
+   fits anywhere.  Returns run_cnt if no run is big enough. */
+static size_t
+run_best_fit (block_sector_t hint, size_t cnt)
+{
+  size_t pos = run_after (hint);
+  size_t lo = pos > NEAR_RUNS ? pos - NEAR_RUNS : 0;
+  size_t hi = pos + NEAR_RUNS < run_cnt ? pos + NEAR_RUNS : run_cnt;
+  size_t best = run_cnt;
+  size_t i;
+
+  for (i = lo; i < hi; i++)
+    if (runs[i].length >= cnt
+        && (best == run_cnt || runs[i].length < runs[best].length))
+      best = i;
+  if (best != run_cnt)
+    return best;
+
+  for (i = 0; i < run_cnt; i++)
+    if (runs[i].length >= cnt
+        && (best == run_cnt || runs[i].length < runs[best].length))
+      best = i;
+  return best;
+}
+
+/* Marks the CNT sectors at SECTOR, in run IDX, as used. */
+static void
+take_sectors (size_t idx, block_sector_t sector, size_t cnt)
+{
+  bitmap_set_multiple (free_map, sector, cnt, true);
+  mark_dirty (sector, cnt);
+  run_take (idx, sector, cnt);
+}
+
 /* Initializes the free map. */
 void
 free_map_init (void) 
@@ -15,38 +201,146 @@ free_map_init (void)
   free_map = bitmap_create (block_size (fs_device));
   if (free_map == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
+  dirty_map = bitmap_create (DIV_ROUND_UP (bitmap_file_size (free_map),
+                                           BLOCK_SECTOR_SIZE));
+  if (dirty_map == NULL)
+    PANIC ("bitmap creation failed--file system device is too large");
+  lock_init (&free_map_lock);
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  index_build ();
+}
+
+/* Marks the free map file sectors that hold the bits of the CNT
+   sectors starting at SECTOR as out of date.  Must hold
+   free_map_lock. */
+static void
+mark_dirty (block_sector_t sector, size_t cnt)
+{
+  size_t first = sector / BITS_PER_SECTOR;
+  size_t last = (sector + cnt - 1) / BITS_PER_SECTOR;
+
+  if (cnt == 0)
+    return;
+  bitmap_set_multiple (dirty_map, first, last - first + 1, true);
 }
 
-/* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
+/* Allocates CNT consecutive sectors from the free map, as close
+   to HINT as possible, and stores the first into *SECTORP.
    Returns true if successful, false if not enough consecutive
-   sectors were available or if the free_map file could not be
-   written. */
+   sectors were available. */
 bool
-free_map_allocate (size_t cnt, block_sector_t *sectorp)
+free_map_allocate (size_t cnt, block_sector_t hint, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  size_t idx;
+
+  lock_acquire (&free_map_lock);
+  idx = run_best_fit (hint, cnt);
+  if (idx < run_cnt)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      *sectorp = runs[idx].start;
+      take_sectors (idx, *sectorp, cnt);
     }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
-  return sector != BITMAP_ERROR;
+  lock_release (&free_map_lock);
+  return idx < run_cnt;
+}
+
+/* Allocates up to CNT consecutive sectors, stores the first into
+   *SECTORP and returns how many were allocated, or 0 if the disk
+   is full.
+   If HINT is free, the run starts there and is as long as the
+   free sectors from HINT on allow.  Otherwise it is the best fit
+   for CNT sectors near HINT, or the largest free run if none is
+   that long. */
+size_t
+free_map_allocate_near (block_sector_t hint, size_t cnt,
+                        block_sector_t *sectorp)
+{
+  size_t idx, n;
+
+  lock_acquire (&free_map_lock);
+  idx = run_after (hint);
+  if (idx > 0 && hint < runs[idx - 1].start + runs[idx - 1].length)
+    {
+      /* HINT is free: extend from there. */
+      idx--;
+      *sectorp = hint;
+      n = runs[idx].start + runs[idx].length - hint;
+    }
+  else
+    {
+      idx = run_best_fit (hint, cnt);
+      if (idx == run_cnt)
+        {
+          size_t i;
+          for (i = 0; i < run_cnt; i++)
+            if (idx == run_cnt || runs[i].length > runs[idx].length)
+              idx = i;
+        }
+      if (idx < run_cnt)
+        {
+          *sectorp = runs[idx].start;
+          n = runs[idx].length;
+        }
+      else
+        n = 0;
+    }
+  if (n > cnt)
+    n = cnt;
+  if (n > 0)
+    take_sectors (idx, *sectorp, n);
+  lock_release (&free_map_lock);
+  return n;
 }
 
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  mark_dirty (sector, cnt);
+  run_give (sector, cnt);
+  lock_release (&free_map_lock);
+}
+
+/* Writes the out of date sectors of the free map file, each run
+   of them with a single write.  The writes go to the buffer
+   cache, which puts them on disk with the rest of the metadata. */
+void
+free_map_flush (void)
+{
+  size_t start, end;
+
+  if (free_map_file == NULL)
+    return;
+
+  lock_acquire (&free_map_lock);
+  start = 0;
+  while ((start = bitmap_scan (dirty_map, start, 1, true)) != BITMAP_ERROR)
+    {
+      for (end = start + 1; end < bitmap_size (dirty_map)
+             && bitmap_test (dirty_map, end); end++)
+        continue;
+      if (!bitmap_write_part (free_map, free_map_file,
+                              start * BLOCK_SECTOR_SIZE,
+                              (end - start) * BLOCK_SECTOR_SIZE))
+        PANIC ("can't write free map");
+      bitmap_set_multiple (dirty_map, start, end - start, false);
+      start = end;
+    }
+  lock_release (&free_map_lock);
+}
+
+/* Writes the out of date sectors of the free map file and then
+   the file itself all the way to disk. */
+void
+free_map_sync (void)
+{
+  free_map_flush ();
+  if (free_map_file != NULL)
+    inode_flush (file_get_inode (free_map_file));
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -58,13 +352,16 @@ free_map_open (void)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  index_build ();
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close (void) 
 {
+  free_map_flush ();
   file_close (free_map_file);
+  free_map_file = NULL;
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -82,4 +379,5 @@ free_map_create (void)
     PANIC ("can't open free map");
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
+  bitmap_set_all (dirty_map, false);
 }
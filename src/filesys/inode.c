@@ -1,23 +1,73 @@
 #include "filesys/inode.h"
+#include <hash.h>
 #include <list.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* A run of consecutive data sectors.  The sectors of an
+   unwritten extent are allocated but were never written: they
+   read as zeros without touching the disk and are only zeroed,
+   in the buffer cache, when data is first written to them. */
+struct extent
+  {
+    block_sector_t start;               /* First sector of the run. */
+    uint32_t length : 31;               /* Number of sectors. */
+    uint32_t unwritten : 1;             /* Never written, reads as zeros. */
+  };
+
+/* Number of extents kept in the inode itself, and in the
+   indirect extent block used once those are full.  A file has
+   at most DIRECT_EXTENTS + INDIRECT_EXTENTS = 125 extents, so
+   its size limit depends on how contiguous it is: the whole
+   disk for a file in one run, but only 125 * GROW_AHEAD sectors
+   (4 MB) for a file whose every growth had to start a new run,
+   as when several files are appended to in turn on a nearly
+   full disk. */
+#define DIRECT_EXTENTS 61
+#define INDIRECT_EXTENTS (BLOCK_SECTOR_SIZE / sizeof (struct extent))
+
+/* Sectors a growing file asks for at once.  A file grows in runs
+   this long when the disk has them, so files appended to a
+   little at a time in turn do not interleave sector by sector
+   and use up their extents.  The unwritten sectors allocated
+   past the end of file are given back when the last opener
+   closes it. */
+#define GROW_AHEAD 64
+
+/* Largest file whose data is kept in the inode sector itself,
+   in the room of the extents it does not need. */
+#define INLINE_MAX (DIRECT_EXTENTS * sizeof (struct extent))
+
+/* Inode flags. */
+#define INODE_INLINE 0x1                /* Data is in inline_data. */
+
 /* On-disk inode.
    Must be exactly BLOCK_SECTOR_SIZE bytes long. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint32_t sector_cnt;                /* Data sectors allocated. */
+    uint32_t extent_cnt;                /* Extents in use. */
+    block_sector_t indirect;            /* Indirect extent block, or 0. */
+    union
+      {
+        struct extent extents[DIRECT_EXTENTS]; /* First extents in file
+                                                  order. */
+        uint8_t inline_data[INLINE_MAX];       /* Data of an inline
+                                                  inode. */
+      };
+    uint32_t flags;                     /* INODE_* flags. */
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -28,40 +78,435 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
 }
 
+/* Returns true if DISK keeps its data in the inode sector.  Such
+   an inode has no data sectors, bytes past its length are zero. */
+static inline bool
+inode_disk_inline (const struct inode_disk *disk)
+{
+  return (disk->flags & INODE_INLINE) != 0;
+}
+
 /* In-memory inode. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in inode table. */
+    struct list_elem lru_elem;          /* Element in closed inode list. */
     block_sector_t sector;              /* Sector number of disk location. */
-    int open_cnt;                       /* Number of openers. */
+    int open_cnt;                       /* Number of openers, 0 if closed. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    struct rwlock rw;                   /* Shared by reads and in-place
+                                           writes, exclusive to grow or
+                                           to write unwritten sectors. */
+    size_t ahead_cnt;                   /* Sectors allocated ahead of
+                                           the writes, see GROW_AHEAD. */
     struct inode_disk data;             /* Inode content. */
   };
 
+/* Reads extent IDX of DISK into *E. */
+static void
+extent_get (const struct inode_disk *disk, size_t idx, struct extent *e)
+{
+  if (idx < DIRECT_EXTENTS)
+    *e = disk->extents[idx];
+  else
+    cache_read (disk->indirect, e, (idx - DIRECT_EXTENTS) * sizeof *e,
+                sizeof *e);
+}
+
+/* Stores *E as extent IDX of DISK. */
+static void
+extent_set (struct inode_disk *disk, size_t idx, const struct extent *e)
+{
+  if (idx < DIRECT_EXTENTS)
+    disk->extents[idx] = *e;
+  else
+    cache_write (disk->indirect, e, (idx - DIRECT_EXTENTS) * sizeof *e,
+                 sizeof *e);
+}
+
+/* Finds data sector IDX of DISK, which must be allocated.
+   Stores the extent that holds it in *E and the extent's index in
+   *I, and returns the position of IDX within the extent. */
+static size_t
+extent_find (const struct inode_disk *disk, size_t idx, size_t *i,
+             struct extent *e)
+{
+  for (*i = 0; *i < disk->extent_cnt; (*i)++)
+    {
+      extent_get (disk, *i, e);
+      if (idx < e->length)
+        return idx;
+      idx -= e->length;
+    }
+  NOT_REACHED ();
+}
+
 /* Returns the block device sector that contains byte offset POS
-   within INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   within INODE, and sets *UNWRITTEN to whether that sector was
+   never written.
+   Returns -1 if INODE has no data sector allocated for a byte at
+   offset POS. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (const struct inode *inode, off_t pos, bool *unwritten)
 {
+  size_t idx = pos / BLOCK_SECTOR_SIZE;
+  struct extent e;
+  size_t i;
+
   ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
-  else
+  *unwritten = false;
+  if (idx >= inode->data.sector_cnt)
     return -1;
+  idx = extent_find (&inode->data, idx, &i, &e);
+  *unwritten = e.unwritten;
+  return e.start + idx;
+}
+
+/* Makes sure DISK can take CNT more extents, allocating the
+   indirect extent block when the inode's own extents run out.
+   Returns false if there is no room. */
+static bool
+extent_room (struct inode_disk *disk, size_t cnt)
+{
+  if (disk->extent_cnt + cnt > DIRECT_EXTENTS + INDIRECT_EXTENTS)
+    return false;
+  if (disk->extent_cnt + cnt > DIRECT_EXTENTS && disk->indirect == 0)
+    {
+      static char zeros[BLOCK_SECTOR_SIZE];
+      if (!free_map_allocate (1, disk->extents[0].start, &disk->indirect))
+        return false;
+      cache_write (disk->indirect, zeros, 0, BLOCK_SECTOR_SIZE);
+    }
+  return true;
+}
+
+/* Adds extent *E to the end of DISK.  Returns false if there is
+   no room left. */
+static bool
+extent_append (struct inode_disk *disk, const struct extent *e)
+{
+  if (!extent_room (disk, 1))
+    return false;
+  extent_set (disk, disk->extent_cnt++, e);
+  return true;
+}
+
+/* Inserts extent *E into DISK as extent IDX, moving the ones
+   from IDX on up by one.  The caller has made room. */
+static void
+extent_insert (struct inode_disk *disk, size_t idx, const struct extent *e)
+{
+  size_t i;
+
+  for (i = disk->extent_cnt; i > idx; i--)
+    {
+      struct extent moved;
+      extent_get (disk, i - 1, &moved);
+      extent_set (disk, i, &moved);
+    }
+  extent_set (disk, idx, e);
+  disk->extent_cnt++;
+}
+
+/* Removes extent IDX from DISK, moving the ones after it down. */
+static void
+extent_remove (struct inode_disk *disk, size_t idx)
+{
+  size_t i;
+
+  for (i = idx + 1; i < disk->extent_cnt; i++)
+    {
+      struct extent moved;
+      extent_get (disk, i, &moved);
+      extent_set (disk, i - 1, &moved);
+    }
+  disk->extent_cnt--;
+}
+
+/* Records that the sector at position K of unwritten extent *E,
+   extent I of DISK, holds data now.  The sector joins a written
+   neighbour it is contiguous with, or the extent is split around
+   it.  If the extent list is too full to split, the whole extent
+   is zeroed in the buffer cache and becomes written. */
+static void
+extent_mark_written (struct inode_disk *disk, size_t i, struct extent *e,
+                     size_t k)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+  struct extent before, sector, after;
+  struct extent neighbour;
+
+  /* Grow the written extent in front of E or behind it. */
+  if (k == 0 && i > 0)
+    {
+      extent_get (disk, i - 1, &neighbour);
+      if (!neighbour.unwritten
+          && neighbour.start + neighbour.length == e->start)
+        {
+          neighbour.length++;
+          extent_set (disk, i - 1, &neighbour);
+          e->start++;
+          if (--e->length == 0)
+            extent_remove (disk, i);
+          else
+            extent_set (disk, i, e);
+          return;
+        }
+    }
+  if (k + 1 == e->length && i + 1 < disk->extent_cnt)
+    {
+      extent_get (disk, i + 1, &neighbour);
+      if (!neighbour.unwritten && neighbour.start == e->start + k + 1)
+        {
+          neighbour.start--;
+          neighbour.length++;
+          extent_set (disk, i + 1, &neighbour);
+          if (--e->length == 0)
+            extent_remove (disk, i);
+          else
+            extent_set (disk, i, e);
+          return;
+        }
+    }
+
+  /* Split E into the unwritten sectors before K, K itself and the
+     unwritten sectors after it. */
+  before = *e;
+  before.length = k;
+  sector.start = e->start + k;
+  sector.length = 1;
+  sector.unwritten = false;
+  after = *e;
+  after.start = e->start + k + 1;
+  after.length = e->length - k - 1;
+  if (!extent_room (disk, (before.length > 0) + (after.length > 0)))
+    {
+      size_t j;
+      for (j = 0; j < e->length; j++)
+        cache_write (e->start + j, zeros, 0, BLOCK_SECTOR_SIZE);
+      e->unwritten = false;
+      extent_set (disk, i, e);
+      return;
+    }
+  if (before.length > 0)
+    {
+      extent_set (disk, i, &before);
+      extent_insert (disk, ++i, &sector);
+    }
+  else
+    extent_set (disk, i, &sector);
+  if (after.length > 0)
+    extent_insert (disk, i + 1, &after);
+}
+
+/* Returns the sector right after the last extent of DISK, or
+   HINT if DISK has no extents. */
+static block_sector_t
+inode_disk_end (const struct inode_disk *disk, block_sector_t hint)
+{
+  struct extent last;
+
+  if (disk->extent_cnt == 0)
+    return hint;
+  extent_get (disk, disk->extent_cnt - 1, &last);
+  return last.start + last.length;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Adds the CNT newly allocated sectors at START to the end of
+   DISK as unwritten data, extending the last extent if they
+   follow it.  Returns false and gives the sectors back if the
+   extent list is full. */
+static bool
+inode_disk_add_run (struct inode_disk *disk, block_sector_t start,
+                    size_t cnt)
+{
+  struct extent e;
+
+  if (disk->extent_cnt > 0)
+    {
+      extent_get (disk, disk->extent_cnt - 1, &e);
+      if (e.unwritten && e.start + e.length == start)
+        {
+          e.length += cnt;
+          extent_set (disk, disk->extent_cnt - 1, &e);
+          disk->sector_cnt += cnt;
+          return true;
+        }
+    }
+  e.start = start;
+  e.length = cnt;
+  e.unwritten = true;
+  if (!extent_append (disk, &e))
+    {
+      free_map_release (start, cnt);
+      return false;
+    }
+  disk->sector_cnt += cnt;
+  return true;
+}
+
+/* Allocates CNT more data sectors at the end of DISK, as
+   unwritten extents that cost no disk write until data lands in
+   them.  Each run is taken right after the last extent when those
+   sectors are free, so a file written front to back stays
+   contiguous; HINT is where the first extent of an empty file
+   should go.  Returns false if the disk or the extent list fills
+   up, the sectors allocated until then stay in DISK. */
+static bool
+inode_disk_grow (struct inode_disk *disk, block_sector_t hint, size_t cnt)
+{
+  while (cnt > 0)
+    {
+      block_sector_t start;
+      size_t n;
+
+      n = free_map_allocate_near (inode_disk_end (disk, hint), cnt, &start);
+      if (n == 0 || !inode_disk_add_run (disk, start, n))
+        return false;
+      cnt -= n;
+    }
+  return true;
+}
+
+/* Like inode_disk_grow(), but asks for WANT sectors, at least
+   CNT, as a single run near the end of DISK, so that a file
+   written a little at a time still grows in long runs.  Stores
+   the number of sectors allocated past CNT in *AHEAD.  Falls
+   back to inode_disk_grow() for CNT if no run that long is
+   free. */
+static bool
+inode_disk_grow_ahead (struct inode_disk *disk, block_sector_t hint,
+                       size_t cnt, size_t want, size_t *ahead)
+{
+  block_sector_t start;
+  size_t n;
+
+  *ahead = 0;
+  n = free_map_allocate_near (inode_disk_end (disk, hint), want, &start);
+  if (n >= cnt)
+    {
+      if (!inode_disk_add_run (disk, start, n))
+        return false;
+      *ahead = n - cnt;
+      return true;
+    }
+  if (n > 0)
+    free_map_release (start, n);
+  return inode_disk_grow (disk, hint, cnt);
+}
+
+/* Gives the sectors INODE was allocated ahead of its writes that
+   still lie past its end back to the free map, and writes the
+   inode if that changed it. */
+static void
+inode_trim (struct inode *inode)
+{
+  struct inode_disk *disk = &inode->data;
+  size_t excess, cnt;
+
+  if (inode_disk_inline (disk))
+    return;
+  excess = disk->sector_cnt - bytes_to_sectors (disk->length);
+  cnt = inode->ahead_cnt < excess ? inode->ahead_cnt : excess;
+  inode->ahead_cnt = 0;
+  if (cnt == 0)
+    return;
+  disk->sector_cnt -= cnt;
+  while (cnt > 0)
+    {
+      struct extent last;
+      size_t n;
+
+      extent_get (disk, disk->extent_cnt - 1, &last);
+      n = last.length < cnt ? last.length : cnt;
+      last.length -= n;
+      free_map_release (last.start + last.length, n);
+      if (last.length == 0)
+        disk->extent_cnt--;
+      else
+        extent_set (disk, disk->extent_cnt - 1, &last);
+      cnt -= n;
+    }
+  cache_write (inode->sector, disk, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Like inode_disk_grow(), but takes the CNT sectors as a single
+   run whenever the disk has one that long, even if that means
+   leaving the sectors right after the last extent alone. */
+static bool
+inode_disk_reserve (struct inode_disk *disk, block_sector_t hint, size_t cnt)
+{
+  block_sector_t end = inode_disk_end (disk, hint);
+  block_sector_t start;
+  size_t n;
+
+  n = free_map_allocate_near (end, cnt, &start);
+  if (n == cnt)
+    return inode_disk_add_run (disk, start, n);
+  if (n > 0)
+    free_map_release (start, n);
+  if (free_map_allocate (cnt, end, &start))
+    return inode_disk_add_run (disk, start, cnt);
+  return inode_disk_grow (disk, hint, cnt);
+}
+
+/* Gives the data sectors and the indirect extent block of DISK
+   back to the free map. */
+static void
+inode_disk_release (struct inode_disk *disk)
+{
+  size_t i;
+
+  if (inode_disk_inline (disk))
+    return;
+  for (i = 0; i < disk->extent_cnt; i++)
+    {
+      struct extent e;
+      extent_get (disk, i, &e);
+      free_map_release (e.start, e.length);
+    }
+  if (disk->indirect != 0)
+    free_map_release (disk->indirect, 1);
+}
+
+/* Open inodes by sector, so that opening a single inode twice
+   returns the same `struct inode'.  The table also holds the
+   inodes on closed_inodes. */
+static struct hash open_inodes;
+
+/* Recently closed inodes that were not removed, least recently
+   closed first.  Reopening one of them needs no disk access. */
+static struct list closed_inodes;
+
+/* Most inodes kept on closed_inodes. */
+#define CLOSED_INODES_MAX 32
+
+/* Protects open_inodes, closed_inodes and the open counts. */
+static struct lock open_inodes_lock;
+
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct inode *inode = hash_entry (e, struct inode, elem);
+  return hash_int (inode->sector);
+}
+
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct inode, elem)->sector
+          < hash_entry (b, struct inode, elem)->sector);
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  hash_init (&open_inodes, inode_hash, inode_less, NULL);
+  list_init (&closed_inodes);
+  lock_init (&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -84,22 +529,21 @@ inode_create (block_sector_t sector, off_t length)
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
+      /* A small file lives in the inode sector, a larger one gets
+         its data right behind the inode if there is room. */
+      if (length <= (off_t) INLINE_MAX)
+        disk_inode->flags = INODE_INLINE;
+      if (inode_disk_inline (disk_inode)
+          || inode_disk_grow (disk_inode, sector + 1,
+                              bytes_to_sectors (length)))
         {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
+          cache_write (sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
           success = true; 
         } 
+      else
+        inode_disk_release (disk_inode);
       free (disk_inode);
     }
   return success;
@@ -111,33 +555,42 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
+  struct hash_elem *e;
   struct inode *inode;
+  struct inode key;
 
-  /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  lock_acquire (&open_inodes_lock);
+
+  /* Check whether this inode is already open or recently closed. */
+  key.sector = sector;
+  e = hash_find (&open_inodes, &key.elem);
+  if (e != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
+      inode = hash_entry (e, struct inode, elem);
+      if (inode->open_cnt++ == 0)
+        list_remove (&inode->lru_elem);
+      lock_release (&open_inodes_lock);
+      return inode; 
     }
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
-    return NULL;
+    {
+      lock_release (&open_inodes_lock);
+      return NULL;
+    }
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize, then hash by the sector just set. */
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  inode->ahead_cnt = 0;
+  rwlock_init (&inode->rw);
+  cache_read (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+  hash_insert (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
@@ -146,7 +599,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -157,8 +614,17 @@ inode_get_inumber (const struct inode *inode)
   return inode->sector;
 }
 
+/* Returns true if INODE has been removed, so it goes away with
+   its last opener. */
+bool
+inode_is_removed (const struct inode *inode)
+{
+  return inode->removed;
+}
+
 /* Closes INODE and writes it to disk.
-   If this was the last reference to INODE, frees its memory.
+   If this was the last reference to INODE, keeps it among the
+   recently closed inodes or frees its memory.
    If INODE was also a removed inode, frees its blocks. */
 void
 inode_close (struct inode *inode) 
@@ -167,22 +633,40 @@ inode_close (struct inode *inode)
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  lock_acquire (&open_inodes_lock);
+  if (--inode->open_cnt > 0)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
-      /* Deallocate blocks if removed. */
-      if (inode->removed) 
+      lock_release (&open_inodes_lock);
+      return;
+    }
+
+  /* Keep the last opener's inode around in case it is reopened
+     soon, dropping the least recently closed one if need be. */
+  if (!inode->removed)
+    {
+      inode_trim (inode);
+      list_push_back (&closed_inodes, &inode->lru_elem);
+      if (list_size (&closed_inodes) <= CLOSED_INODES_MAX)
         {
-          free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          lock_release (&open_inodes_lock);
+          return;
         }
+      inode = list_entry (list_pop_front (&closed_inodes),
+                          struct inode, lru_elem);
+    }
 
-      free (inode); 
+  /* Release resources of an inode nobody has open any more. */
+  hash_delete (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+ 
+  /* Deallocate blocks if removed. */
+  if (inode->removed) 
+    {
+      free_map_release (inode->sector, 1);
+      inode_disk_release (&inode->data);
     }
+
+  free (inode); 
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -194,20 +678,38 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
-/* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
-   Returns the number of bytes actually read, which may be less
-   than SIZE if an error occurs or end of file is reached. */
-off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+/* User data is copied through kernel buffers of this many bytes.
+   A page fault on a user buffer may need to read a page of the
+   same file in, so it must never happen while a buffer cache
+   entry or the inode's lock is held. */
+#define BOUNCE_SIZE PGSIZE
+
+/* Reads SIZE bytes from INODE into kernel buffer BUFFER, starting
+   at position OFFSET.  See inode_read_at(). */
+static off_t
+inode_read_kernel (struct inode *inode, void *buffer_, off_t size,
+                   off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
 
+  rwlock_acquire_read (&inode->rw);
+  if (inode_disk_inline (&inode->data))
+    {
+      if (offset < inode_length (inode))
+        {
+          bytes_read = inode_length (inode) - offset;
+          if (bytes_read > size)
+            bytes_read = size;
+          memcpy (buffer, inode->data.inline_data + offset, bytes_read);
+        }
+      size = 0;
+    }
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      bool unwritten;
+      block_sector_t sector_idx = byte_to_sector (inode, offset, &unwritten);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -220,59 +722,242 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+      /* Copy the chunk out of the buffer cache.  A sector that
+         was never written holds zeros and is not read at all. */
+      if (unwritten)
+        memset (buffer + bytes_read, 0, chunk_size);
+      else
+        cache_read (sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
+
+  rwlock_release_read (&inode->rw);
 
   return bytes_read;
 }
 
-/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
-   Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
-off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
-                off_t offset) 
+/* Asks the buffer cache to fetch the sectors that hold LENGTH
+   bytes of INODE starting at OFFSET in the background.  Bytes
+   past the end of INODE are ignored. */
+void
+inode_readahead (struct inode *inode, off_t offset, off_t length)
+{
+  off_t end = offset + length;
+
+  if (inode_disk_inline (&inode->data))
+    return;
+  if (end > inode_length (inode))
+    end = inode_length (inode);
+  for (offset = ROUND_DOWN (offset, BLOCK_SECTOR_SIZE); offset < end;
+       offset += BLOCK_SECTOR_SIZE)
+    {
+      bool unwritten;
+      block_sector_t sector = byte_to_sector (inode, offset, &unwritten);
+      if (!unwritten)
+        cache_readahead (sector);
+    }
+}
+
+/* Returns true if any of the SIZE bytes of INODE at OFFSET lie in
+   sectors that were never written. */
+static bool
+inode_range_unwritten (const struct inode *inode, off_t offset, off_t size)
+{
+  size_t first = offset / BLOCK_SECTOR_SIZE;
+  size_t last = (offset + size - 1) / BLOCK_SECTOR_SIZE;
+  size_t idx = 0;
+  size_t i;
+
+  for (i = 0; i < inode->data.extent_cnt && idx <= last; i++)
+    {
+      struct extent e;
+      extent_get (&inode->data, i, &e);
+      if (e.unwritten && idx + e.length > first)
+        return true;
+      idx += e.length;
+    }
+  return false;
+}
+
+/* Returns the sector that holds byte POS of INODE, ready to be
+   written.  A sector that was never written is recorded as
+   written, which needs INODE's lock for writing, and is zeroed in
+   the buffer cache first unless FULL says the caller overwrites
+   all of it. */
+static block_sector_t
+sector_for_write (struct inode *inode, off_t pos, bool full)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+  struct extent e;
+  block_sector_t sector;
+  size_t i, k;
+
+  k = extent_find (&inode->data, pos / BLOCK_SECTOR_SIZE, &i, &e);
+  sector = e.start + k;
+  if (e.unwritten)
+    {
+      if (!full)
+        cache_write (sector, zeros, 0, BLOCK_SECTOR_SIZE);
+      extent_mark_written (&inode->data, i, &e, k);
+    }
+  return sector;
+}
+
+/* Moves the data of inline INODE out to a data sector, so that
+   it can grow past INLINE_MAX bytes.  The caller holds INODE's
+   lock for writing.  Returns false if memory or disk allocation
+   fails, INODE is then left as it was. */
+static bool
+inode_move_inline (struct inode *inode)
+{
+  struct inode_disk *disk = &inode->data;
+  uint8_t *data;
+
+  data = malloc (INLINE_MAX);
+  if (data == NULL)
+    return false;
+  memcpy (data, disk->inline_data, INLINE_MAX);
+  memset (disk->extents, 0, sizeof disk->extents);
+  disk->flags &= ~INODE_INLINE;
+  if (!inode_disk_grow (disk, inode->sector + 1, 1))
+    {
+      memcpy (disk->inline_data, data, INLINE_MAX);
+      disk->flags |= INODE_INLINE;
+      free (data);
+      return false;
+    }
+  cache_write (sector_for_write (inode, 0, false), data, 0, INLINE_MAX);
+  free (data);
+  return true;
+}
+
+/* Allocates the data sectors that hold the LENGTH bytes of INODE
+   at OFFSET, as unwritten sectors that read as zeros, without
+   changing INODE's length.  Writes into the range later neither
+   allocate nor touch the free map, and a range allocated in one
+   call is one contiguous run whenever the disk has room for it.
+   Returns false if INODE denies writes or the disk fills up; the
+   sectors allocated until then stay with INODE. */
+bool
+inode_allocate (struct inode *inode, off_t offset, off_t length)
+{
+  size_t sectors = bytes_to_sectors (offset + length);
+  bool success = true;
+
+  ASSERT (offset >= 0 && length >= 0);
+  if (inode->deny_write_cnt)
+    return false;
+  if (length == 0)
+    return true;
+
+  rwlock_acquire_write (&inode->rw);
+  if (inode_disk_inline (&inode->data))
+    {
+      /* Room in the inode sector needs no allocation. */
+      if (offset + length <= (off_t) INLINE_MAX)
+        {
+          rwlock_release_write (&inode->rw);
+          return true;
+        }
+      if (!inode_move_inline (inode))
+        {
+          rwlock_release_write (&inode->rw);
+          return false;
+        }
+    }
+  /* The reservation keeps what was allocated ahead as well. */
+  inode->ahead_cnt = 0;
+  if (sectors > inode->data.sector_cnt)
+    success = inode_disk_reserve (&inode->data, inode->sector + 1,
+                                  sectors - inode->data.sector_cnt);
+  cache_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+  rwlock_release_write (&inode->rw);
+  return success;
+}
+
+/* Writes SIZE bytes from kernel buffer BUFFER into INODE,
+   starting at OFFSET.  See inode_write_at(). */
+static off_t
+inode_write_kernel (struct inode *inode, const void *buffer_, off_t size,
+                    off_t offset)
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  off_t length = inode_length (inode);
+  bool growing = size > 0 && offset + size > length;
+  bool exclusive = growing;
 
   if (inode->deny_write_cnt)
     return 0;
 
+  if (!growing)
+    {
+      /* Writing sectors for the first time changes the extents. */
+      rwlock_acquire_read (&inode->rw);
+      if (size > 0 && !inode_disk_inline (&inode->data)
+          && inode_range_unwritten (inode, offset, size))
+        {
+          rwlock_release_read (&inode->rw);
+          rwlock_acquire_write (&inode->rw);
+          exclusive = true;
+        }
+    }
+  else
+    {
+      /* Allocate the new sectors first.  The length is only
+         raised once the data is written, so readers never see
+         the new bytes before they are there. */
+      size_t sectors = bytes_to_sectors (offset + size);
+      rwlock_acquire_write (&inode->rw);
+      if (inode_disk_inline (&inode->data)
+          && offset + size > (off_t) INLINE_MAX
+          && !inode_move_inline (inode))
+        {
+          rwlock_release_write (&inode->rw);
+          return 0;
+        }
+      length = offset + size;
+      if (!inode_disk_inline (&inode->data))
+        {
+          if (sectors > inode->data.sector_cnt)
+            {
+              size_t ahead;
+              if (inode_disk_grow_ahead (&inode->data, inode->sector + 1,
+                                         sectors - inode->data.sector_cnt,
+                                         ROUND_UP (sectors, GROW_AHEAD)
+                                         - inode->data.sector_cnt,
+                                         &ahead))
+                inode->ahead_cnt += ahead;
+            }
+          if (length > (off_t) inode->data.sector_cnt * BLOCK_SECTOR_SIZE)
+            length = inode->data.sector_cnt * BLOCK_SECTOR_SIZE;
+        }
+    }
+
+  if (inode_disk_inline (&inode->data))
+    {
+      /* The data goes into the inode sector itself. */
+      if (size > 0 && offset < length)
+        {
+          bytes_written = length - offset < size ? length - offset : size;
+          memcpy (inode->data.inline_data + offset, buffer, bytes_written);
+          offset += bytes_written;
+          if (!exclusive)
+            cache_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+        }
+      size = 0;
+    }
   while (size > 0) 
     {
-      /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      /* Starting byte offset within the sector to write. */
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      off_t inode_left = length - offset;
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
@@ -281,42 +966,133 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
-        }
-      else 
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
-        }
+      /* Write the chunk into the buffer cache, which reads the
+         rest of the sector first if the chunk does not cover it. */
+      cache_write (sector_for_write (inode, offset,
+                                     chunk_size == BLOCK_SECTOR_SIZE), buffer + bytes_written, sector_ofs,
+                   chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
+
+  if (!exclusive)
+    rwlock_release_read (&inode->rw);
+  else
+    {
+      if (offset > inode->data.length)
+        inode->data.length = offset;
+      cache_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+      rwlock_release_write (&inode->rw);
+    }
+
+  return bytes_written;
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
+   Returns the number of bytes actually read, which may be less
+   than SIZE if an error occurs or end of file is reached.
+   A user BUFFER is filled through a kernel buffer, after the
+   locks of each piece have been released. */
+off_t
+inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+{
+  uint8_t *buffer = buffer_;
+  uint8_t *bounce;
+  off_t bytes_read = 0;
+
+  if (!is_user_vaddr (buffer) || size <= 0)
+    return inode_read_kernel (inode, buffer, size, offset);
+  bounce = malloc (BOUNCE_SIZE);
+  if (bounce == NULL)
+    return 0;
+  while (size > 0)
+    {
+      off_t chunk = size < BOUNCE_SIZE ? size : BOUNCE_SIZE;
+      off_t n = inode_read_kernel (inode, bounce, chunk, offset);
+      memcpy (buffer + bytes_read, bounce, n);
+      bytes_read += n;
+      if (n < chunk)
+        break;
+      size -= n;
+      offset += n;
+    }
   free (bounce);
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+   Returns the number of bytes actually written, which may be
+   less than SIZE if end of file is reached or an error occurs.
+   The data lands in the buffer cache, the flusher thread or
+   cache_flush() writes it to disk.
+   A write past end of file extends the inode, any gap before
+   OFFSET reads back as zeros.
+   A user BUFFER is copied into a kernel buffer before the locks
+   of each piece are taken. */
+off_t
+inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+                off_t offset) 
+{
+  const uint8_t *buffer = buffer_;
+  uint8_t *bounce;
+  off_t bytes_written = 0;
 
+  if (!is_user_vaddr (buffer) || size <= 0)
+    return inode_write_kernel (inode, buffer, size, offset);
+  bounce = malloc (BOUNCE_SIZE);
+  if (bounce == NULL)
+    return 0;
+  while (size > 0)
+    {
+      off_t chunk = size < BOUNCE_SIZE ? size : BOUNCE_SIZE;
+      off_t n;
+      memcpy (bounce, buffer + bytes_written, chunk);
+      n = inode_write_kernel (inode, bounce, chunk, offset);
+      bytes_written += n;
+      if (n < chunk)
+        break;
+      size -= n;
+      offset += n;
+    }
+  free (bounce);
   return bytes_written;
 }
 
+/* Writes the dirty data sectors of INODE from the buffer cache
+   to disk.  Unwritten extents have nothing to write. */
+void
+inode_flush_data (struct inode *inode)
+{
+  size_t i;
+
+  rwlock_acquire_read (&inode->rw);
+  if (!inode_disk_inline (&inode->data))
+    for (i = 0; i < inode->data.extent_cnt; i++)
+      {
+        struct extent e;
+        extent_get (&inode->data, i, &e);
+        if (!e.unwritten)
+          cache_flush_range (e.start, e.length);
+      }
+  rwlock_release_read (&inode->rw);
+}
+
+/* Writes INODE's dirty data to disk, then the sectors that
+   describe it: the indirect extent block and the inode itself. */
+void
+inode_flush (struct inode *inode)
+{
+  inode_flush_data (inode);
+  rwlock_acquire_read (&inode->rw);
+  if (inode->data.indirect != 0)
+    cache_flush_range (inode->data.indirect, 1);
+  cache_flush_range (inode->sector, 1);
+  rwlock_release_read (&inode->rw);
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
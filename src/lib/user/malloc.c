@@ -0,0 +1,486 @@
+#include <malloc.h>
+#include <debug.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* A size-class implementation of malloc() for user programs,
+   layered on the sbrk() system call.
+
+   The size of each request, in bytes, is rounded up to a power
+   of 2 and assigned to the "descriptor" that manages blocks of
+   that size.  Blocks of one size are carved out of page-sized
+   "arenas".  Every arena keeps its own free list, and each
+   descriptor keeps a list of the arenas that still have a free
+   block, so malloc() and free() only ever touch the one page
+   they work on.  The blocks of a fresh arena are handed out in
+   address order before its free list is used, so the kernel
+   zero-fills the arena's page on first touch and never for
+   blocks that are not used yet.
+
+   When the last block of an arena is freed, the arena is given
+   back to the page pool unless it is the only arena left with
+   free blocks for its size, which keeps a malloc()/free() pair
+   in a loop from bouncing a page in and out of the heap.
+
+   Blocks bigger than 1 kB don't fit in a page with a header, so
+   they get a run of whole pages with the page count stored in
+   the arena header.
+
+   The page pool is a list of free page runs kept in address
+   order, coalesced with their neighbours on release.  Whenever
+   the highest run ends at the current break, it is returned to
+   the kernel with a negative sbrk(). */
+
+/* Size of a page, as used by the kernel. */
+#define PAGE_SIZE 4096
+
+/* Descriptor. */
+struct desc
+  {
+    size_t block_size;          /* Size of each element in bytes. */
+    size_t blocks_per_arena;    /* Number of blocks in an arena. */
+    struct arena *partial;      /* Arenas with at least one free block. */
+  };
+
+/* Magic number for detecting arena corruption. */
+#define ARENA_MAGIC 0x9a548eed
+
+/* Arena. */
+struct arena
+  {
+    unsigned magic;             /* Always set to ARENA_MAGIC. */
+    struct desc *desc;          /* Owning descriptor, null for big block. */
+    size_t free_cnt;            /* Free blocks; pages in big block. */
+    size_t unused_idx;          /* First block never handed out. */
+    struct block *free_list;    /* Blocks freed back to this arena. */
+    struct arena *prev;         /* Previous arena in desc->partial. */
+    struct arena *next;         /* Next arena in desc->partial. */
+  };
+
+/* Free block. */
+struct block
+  {
+    struct block *next;         /* Next free block in the arena. */
+  };
+
+/* A run of free pages in the heap. */
+struct page_run
+  {
+    size_t page_cnt;            /* Number of pages in the run. */
+    struct page_run *next;      /* Next run, at a higher address. */
+  };
+
+/* Our set of descriptors. */
+static struct desc descs[10];   /* Descriptors. */
+static size_t desc_cnt;         /* Number of descriptors. */
+
+/* Free page runs, in increasing address order. */
+static struct page_run *free_runs;
+
+static void malloc_init (void);
+static struct arena *block_to_arena (struct block *);
+static struct block *arena_to_block (struct arena *, size_t idx);
+static void arena_link (struct desc *, struct arena *);
+static void arena_unlink (struct desc *, struct arena *);
+static void *get_pages (size_t page_cnt);
+static void put_pages (void *, size_t page_cnt);
+static bool extend_pages (struct arena *, size_t page_cnt);
+
+/* Initializes the malloc() descriptors and page-aligns the
+   break, in case the program moved it by itself. */
+static void
+malloc_init (void)
+{
+  size_t block_size;
+  uintptr_t brk;
+
+  for (block_size = 16; block_size < PAGE_SIZE / 2; block_size *= 2)
+    {
+      struct desc *d = &descs[desc_cnt++];
+      ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+      d->block_size = block_size;
+      d->blocks_per_arena = (PAGE_SIZE - sizeof (struct arena)) / block_size;
+      d->partial = NULL;
+    }
+
+  brk = (uintptr_t) sbrk (0);
+  if (brk % PAGE_SIZE != 0)
+    sbrk (PAGE_SIZE - brk % PAGE_SIZE);
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size)
+{
+  struct desc *d;
+  struct block *b;
+  struct arena *a;
+
+  /* A null pointer satisfies a request for 0 bytes. */
+  if (size == 0)
+    return NULL;
+
+  if (desc_cnt == 0)
+    malloc_init ();
+
+  /* Find the smallest descriptor that satisfies a SIZE-byte
+     request. */
+  for (d = descs; d < descs + desc_cnt; d++)
+    if (d->block_size >= size)
+      break;
+  if (d == descs + desc_cnt)
+    {
+      /* SIZE is too big for any descriptor.
+         Allocate enough pages to hold SIZE plus an arena. */
+      size_t page_cnt;
+
+      if (size + sizeof *a < size)
+        return NULL;
+      page_cnt = DIV_ROUND_UP (size + sizeof *a, PAGE_SIZE);
+      a = get_pages (page_cnt);
+      if (a == NULL)
+        return NULL;
+
+      /* Initialize the arena to indicate a big block of PAGE_CNT
+         pages, and return it. */
+      a->magic = ARENA_MAGIC;
+      a->desc = NULL;
+      a->free_cnt = page_cnt;
+      return a + 1;
+    }
+
+  /* If no arena has a free block, create a new arena. */
+  if (d->partial == NULL)
+    {
+      a = get_pages (1);
+      if (a == NULL)
+        return NULL;
+
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->free_cnt = d->blocks_per_arena;
+      a->unused_idx = 0;
+      a->free_list = NULL;
+      arena_link (d, a);
+    }
+
+  /* Take a block from the first arena with room, preferring
+     blocks that were freed over ones never touched. */
+  a = d->partial;
+  if (a->free_list != NULL)
+    {
+      b = a->free_list;
+      a->free_list = b->next;
+    }
+  else
+    b = arena_to_block (a, a->unused_idx++);
+  if (--a->free_cnt == 0)
+    arena_unlink (d, a);
+  return b;
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b)
+{
+  void *p;
+  size_t size;
+
+  /* Calculate block size and make sure it fits in size_t. */
+  size = a * b;
+  if (a != 0 && size / a != b)
+    return NULL;
+
+  /* Allocate and zero memory. */
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+
+  return p;
+}
+
+/* Returns the number of bytes allocated for BLOCK. */
+static size_t
+block_size (void *block)
+{
+  struct block *b = block;
+  struct arena *a = block_to_arena (b);
+  struct desc *d = a->desc;
+
+  return d != NULL ? d->block_size : PAGE_SIZE * a->free_cnt - sizeof *a;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer.
+   A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK).
+   A block that still fits is returned unchanged, and a big block
+   is grown in place when the pages after it are free. */
+void *
+realloc (void *old_block, size_t new_size)
+{
+  struct arena *a;
+  size_t old_size;
+  void *new_block;
+
+  if (new_size == 0)
+    {
+      free (old_block);
+      return NULL;
+    }
+  if (old_block == NULL)
+    return malloc (new_size);
+
+  old_size = block_size (old_block);
+  if (new_size <= old_size)
+    return old_block;
+
+  a = block_to_arena (old_block);
+  if (a->desc == NULL && new_size + sizeof *a > new_size
+      && extend_pages (a, DIV_ROUND_UP (new_size + sizeof *a, PAGE_SIZE)))
+    return old_block;
+
+  new_block = malloc (new_size);
+  if (new_block != NULL)
+    {
+      memcpy (new_block, old_block, old_size);
+      free (old_block);
+    }
+  return new_block;
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p)
+{
+  if (p != NULL)
+    {
+      struct block *b = p;
+      struct arena *a = block_to_arena (b);
+      struct desc *d = a->desc;
+
+      if (d != NULL)
+        {
+          /* It's a normal block.  Put it on its arena's free
+             list, making the arena available again if it was
+             full. */
+          b->next = a->free_list;
+          a->free_list = b;
+          if (a->free_cnt++ == 0)
+            arena_link (d, a);
+
+          /* If the arena is now entirely unused and another arena
+             can serve this size, free it. */
+          if (a->free_cnt >= d->blocks_per_arena
+              && (d->partial != a || a->next != NULL))
+            {
+              ASSERT (a->free_cnt == d->blocks_per_arena);
+              arena_unlink (d, a);
+              put_pages (a, 1);
+            }
+        }
+      else
+        {
+          /* It's a big block.  Free its pages. */
+          put_pages (a, a->free_cnt);
+        }
+    }
+}
+
+/* Returns the arena that block B is inside. */
+static struct arena *
+block_to_arena (struct block *b)
+{
+  struct arena *a = (struct arena *) ((uintptr_t) b & ~(PAGE_SIZE - 1));
+  size_t ofs = (uintptr_t) b & (PAGE_SIZE - 1);
+
+  /* Check that the arena is valid. */
+  ASSERT (a != NULL);
+  ASSERT (a->magic == ARENA_MAGIC);
+
+  /* Check that the block is properly aligned for the arena. */
+  ASSERT (a->desc == NULL
+          || (ofs - sizeof *a) % a->desc->block_size == 0);
+  ASSERT (a->desc != NULL || ofs == sizeof *a);
+
+  return a;
+}
+
+/* Returns the IDX'th block within arena A. */
+static struct block *
+arena_to_block (struct arena *a, size_t idx)
+{
+  ASSERT (a != NULL);
+  ASSERT (a->magic == ARENA_MAGIC);
+  ASSERT (idx < a->desc->blocks_per_arena);
+  return (struct block *) ((uint8_t *) a
+                           + sizeof *a
+                           + idx * a->desc->block_size);
+}
+
+/* Adds A to the front of D's list of arenas with free blocks. */
+static void
+arena_link (struct desc *d, struct arena *a)
+{
+  a->prev = NULL;
+  a->next = d->partial;
+  if (d->partial != NULL)
+    d->partial->prev = a;
+  d->partial = a;
+}
+
+/* Removes A from D's list of arenas with free blocks. */
+static void
+arena_unlink (struct desc *d, struct arena *a)
+{
+  if (a->prev != NULL)
+    a->prev->next = a->next;
+  else
+    d->partial = a->next;
+  if (a->next != NULL)
+    a->next->prev = a->prev;
+}
+
+/* Returns the first byte past the end of run R. */
+static uint8_t *
+run_end (struct page_run *r)
+{
+  return (uint8_t *) r + r->page_cnt * PAGE_SIZE;
+}
+
+/* Obtains PAGE_CNT contiguous pages, from the lowest free run
+   that is big enough or else by moving the break.
+   Returns a null pointer if memory is not available. */
+static void *
+get_pages (size_t page_cnt)
+{
+  struct page_run **rp, *r;
+  uint8_t *brk, *p;
+
+  for (rp = &free_runs; *rp != NULL; rp = &(*rp)->next)
+    {
+      r = *rp;
+      if (r->page_cnt < page_cnt)
+        continue;
+
+      /* Take pages from the low end of the run, so that the top
+         of the heap stays free for as long as possible. */
+      if (r->page_cnt > page_cnt)
+        {
+          struct page_run *rest = (struct page_run *) ((uint8_t *) r
+                                                       + page_cnt * PAGE_SIZE);
+          rest->page_cnt = r->page_cnt - page_cnt;
+          rest->next = r->next;
+          *rp = rest;
+        }
+      else
+        *rp = r->next;
+      return r;
+    }
+
+  if (page_cnt > (size_t) INT32_MAX / PAGE_SIZE)
+    return NULL;
+
+  /* If the highest free run ends at the break, grow the heap by
+     only as much as that run is short of. */
+  brk = sbrk (0);
+  for (rp = &free_runs; *rp != NULL && (*rp)->next != NULL;
+       rp = &(*rp)->next)
+    continue;
+  r = *rp;
+  if (r != NULL && run_end (r) == brk)
+    {
+      if (sbrk ((page_cnt - r->page_cnt) * PAGE_SIZE) == (void *) -1)
+        return NULL;
+      *rp = NULL;
+      return r;
+    }
+
+  p = sbrk (page_cnt * PAGE_SIZE);
+  return p != (void *) -1 ? p : NULL;
+}
+
+/* Returns the PAGE_CNT pages at PAGES to the free runs, merging
+   them with adjacent runs.  If that leaves a run at the top of
+   the heap, gives it back to the kernel. */
+static void
+put_pages (void *pages, size_t page_cnt)
+{
+  struct page_run *r = pages;
+  struct page_run **rp, **prev_rp = NULL;
+
+  /* Find the first run above PAGES and insert before it. */
+  for (rp = &free_runs; *rp != NULL && *rp < r; rp = &(*rp)->next)
+    prev_rp = rp;
+  r->page_cnt = page_cnt;
+  r->next = *rp;
+  *rp = r;
+
+  /* Merge with the following run. */
+  if (r->next != NULL && run_end (r) == (uint8_t *) r->next)
+    {
+      r->page_cnt += r->next->page_cnt;
+      r->next = r->next->next;
+    }
+
+  /* Merge with the preceding run. */
+  if (prev_rp != NULL && run_end (*prev_rp) == (uint8_t *) r)
+    {
+      (*prev_rp)->page_cnt += r->page_cnt;
+      (*prev_rp)->next = r->next;
+      rp = prev_rp;
+      r = *rp;
+    }
+
+  /* Trim the top of the heap. */
+  if (r->next == NULL && run_end (r) == (uint8_t *) sbrk (0)
+      && sbrk (-(int) (r->page_cnt * PAGE_SIZE)) != (void *) -1)
+    *rp = NULL;
+}
+
+/* Tries to grow big block arena A in place to PAGE_CNT pages,
+   using the free run right after it or the break if A is at the
+   top of the heap.  Returns true if successful. */
+static bool
+extend_pages (struct arena *a, size_t page_cnt)
+{
+  uint8_t *end = (uint8_t *) a + a->free_cnt * PAGE_SIZE;
+  size_t extra = page_cnt - a->free_cnt;
+  struct page_run **rp;
+
+  for (rp = &free_runs; *rp != NULL && (uint8_t *) *rp < end;
+       rp = &(*rp)->next)
+    continue;
+
+  if (*rp != NULL && (uint8_t *) *rp == end)
+    {
+      struct page_run *r = *rp;
+      if (r->page_cnt < extra)
+        return false;
+      if (r->page_cnt > extra)
+        {
+          struct page_run *rest = (struct page_run *) (end
+                                                       + extra * PAGE_SIZE);
+          rest->page_cnt = r->page_cnt - extra;
+          rest->next = r->next;
+          *rp = rest;
+        }
+      else
+        *rp = r->next;
+    }
+  else if (*rp != NULL || end != (uint8_t *) sbrk (0)
+           || extra > (size_t) INT32_MAX / PAGE_SIZE
+           || sbrk (extra * PAGE_SIZE) == (void *) -1)
+    return false;
+
+  a->free_cnt = page_cnt;
+  return true;
+}
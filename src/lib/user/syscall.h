@@ -2,6 +2,7 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <debug.h>
 
 /* Process identifier. */
@@ -12,6 +13,62 @@ typedef int pid_t;
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
 
+/* One buffer of a readv() or writev() call. */
+struct iovec
+  {
+    void *iov_base;             /* Start of the buffer. */
+    size_t iov_len;             /* Size of the buffer in bytes. */
+  };
+
+/* Most buffers in one readv() or writev() call. */
+#define IOV_MAX 64
+
+/* Asynchronous I/O.  aio_setup() maps a ring page and a buffer
+   area into the process.  The process fills submission entries
+   and advances sq_tail, aio_enter() hands all of them to kernel
+   worker threads, and completions show up at cq_tail for the
+   process to reap by advancing cq_head, without a system call.
+   Entry I of a ring is in slot I % AIO_ENTRIES.  Data and the
+   names to open must lie in the buffer area. */
+#define AIO_ENTRIES 64          /* Entries of each ring. */
+#define AIO_BUF_MAX (16 * 4096) /* Largest buffer area. */
+
+#define AIO_READ 0              /* Read LEN bytes at OFFSET into BUF. */
+#define AIO_WRITE 1             /* Write LEN bytes at OFFSET from BUF. */
+#define AIO_FSYNC 2             /* fsync() FD. */
+#define AIO_OPEN 3              /* Open the LEN-byte name at BUF. */
+
+/* A submission entry. */
+struct aio_sqe
+  {
+    int op;                     /* AIO_READ, AIO_WRITE, ... */
+    int fd;                     /* File, unused by AIO_OPEN. */
+    void *buf;                  /* Inside the buffer area. */
+    unsigned len;               /* Bytes to transfer. */
+    unsigned offset;            /* File offset. */
+    unsigned user_data;         /* Handed back in the completion. */
+  };
+
+/* A completion entry. */
+struct aio_cqe
+  {
+    unsigned user_data;         /* From the submission. */
+    int result;                 /* Bytes, 0, new fd, or -1 on error. */
+  };
+
+/* The shared ring page. */
+struct aio_ring
+  {
+    volatile unsigned sq_head;  /* Submissions taken by the kernel. */
+    volatile unsigned sq_tail;  /* Submissions filled in. */
+    volatile unsigned cq_head;  /* Completions reaped. */
+    volatile unsigned cq_tail;  /* Completions posted by the kernel. */
+    void *buf;                  /* Buffer area. */
+    unsigned buf_size;          /* Size of the buffer area. */
+    struct aio_sqe sq[AIO_ENTRIES];
+    struct aio_cqe cq[AIO_ENTRIES];
+  };
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -45,4 +102,19 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+void *sbrk (int increment);
+mapid_t mmap_anon (void **addr, unsigned length);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int copy_file_range (int fd_in, int off_in, int fd_out, int off_out,
+                     unsigned length);
+int fallocate (int fd, unsigned offset, unsigned length);
+int fsync (int fd);
+void sync (void);
+struct aio_ring *aio_setup (unsigned buf_size);
+int aio_enter (unsigned min_complete);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,92 @@
+/* Sets up an asynchronous I/O ring, opens a file, writes to it,
+   reads it back and syncs it through the ring, reaping each
+   completion straight from the shared page.  Also checks that
+   entries with a bad descriptor or a buffer outside the buffer
+   area complete with -1. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BUF_SIZE 8192
+#define DATA 4000
+
+static struct aio_ring *ring;
+
+/* Queues one submission. */
+static void
+queue (int op, int fd, void *buf, unsigned len, unsigned offset,
+       unsigned user_data)
+{
+  struct aio_sqe *sqe = &ring->sq[ring->sq_tail % AIO_ENTRIES];
+
+  sqe->op = op;
+  sqe->fd = fd;
+  sqe->buf = buf;
+  sqe->len = len;
+  sqe->offset = offset;
+  sqe->user_data = user_data;
+  ring->sq_tail++;
+}
+
+/* Submits everything queued, waits for one completion and
+   returns its result, checking that it carries USER_DATA. */
+static int
+reap (unsigned user_data)
+{
+  struct aio_cqe *cqe;
+  int result;
+
+  aio_enter (1);
+  if (ring->cq_head == ring->cq_tail)
+    fail ("no completion for %u", user_data);
+  cqe = &ring->cq[ring->cq_head % AIO_ENTRIES];
+  if (cqe->user_data != user_data)
+    fail ("completion for %u, expected %u", cqe->user_data, user_data);
+  result = cqe->result;
+  ring->cq_head++;
+  return result;
+}
+
+void
+test_main (void)
+{
+  char *buf;
+  int fd;
+  int i;
+
+  CHECK ((ring = aio_setup (BUF_SIZE)) != NULL, "aio_setup");
+  CHECK (aio_setup (BUF_SIZE) == NULL, "second aio_setup fails");
+  buf = ring->buf;
+
+  CHECK (create ("data", 0), "create \"data\"");
+  strlcpy (buf, "data", BUF_SIZE);
+  queue (AIO_OPEN, 0, buf, BUF_SIZE, 0, 1);
+  CHECK ((fd = reap (1)) > 1, "open \"data\" through the ring");
+
+  for (i = 0; i < DATA; i++)
+    buf[i] = 'a' + i % 26;
+  queue (AIO_WRITE, fd, buf, DATA, 0, 2);
+  CHECK (reap (2) == DATA, "write %d bytes", DATA);
+  CHECK (filesize (fd) == DATA, "size is %d", DATA);
+
+  memset (buf, 0, BUF_SIZE);
+  queue (AIO_READ, fd, buf + DATA, DATA, 0, 3);
+  CHECK (reap (3) == DATA, "read %d bytes", DATA);
+  for (i = 0; i < DATA; i++)
+    if (buf[DATA + i] != 'a' + i % 26)
+      fail ("byte %d is wrong", i);
+
+  queue (AIO_FSYNC, fd, NULL, 0, 0, 4);
+  CHECK (reap (4) == 0, "fsync");
+
+  queue (AIO_READ, 1234, buf, DATA, 0, 5);
+  CHECK (reap (5) == -1, "read bad fd fails");
+  queue (AIO_READ, fd, buf + BUF_SIZE - 10, 20, 0, 6);
+  CHECK (reap (6) == -1, "read past buffer area fails");
+  queue (AIO_WRITE, fd, (void *) test_main, 20, 0, 7);
+  CHECK (reap (7) == -1, "write from outside buffer area fails");
+
+  close (fd);
+}
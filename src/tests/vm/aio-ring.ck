@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(aio-ring) begin
+(aio-ring) aio_setup
+(aio-ring) second aio_setup fails
+(aio-ring) create "data"
+(aio-ring) open "data" through the ring
+(aio-ring) write 4000 bytes
+(aio-ring) size is 4000
+(aio-ring) read 4000 bytes
+(aio-ring) fsync
+(aio-ring) read bad fd fails
+(aio-ring) read past buffer area fails
+(aio-ring) write from outside buffer area fails
+(aio-ring) end
+EOF
+pass;
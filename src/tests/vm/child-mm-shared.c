@@ -0,0 +1,26 @@
+/* Child process of mmap-shared.
+   Maps the file its parent has mapped and written to, checks that
+   the parent's bytes are there, writes the second page and exits
+   without calling munmap. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/shared.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x20000000;
+  int handle;
+  size_t i;
+
+  CHECK ((handle = open ("shared")) > 1, "open \"shared\"");
+  CHECK (mmap (handle, actual) != MAP_FAILED, "mmap \"shared\"");
+  for (i = 0; i < PAGE_SIZE; i++)
+    if (actual[i] != PARENT_BYTE)
+      fail ("byte %zu of the parent's page is %d", i, actual[i]);
+  msg ("parent's write visible through the mapping");
+  memset (actual + PAGE_SIZE, CHILD_BYTE, PAGE_SIZE);
+}
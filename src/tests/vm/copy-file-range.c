@@ -0,0 +1,51 @@
+/* Copies part of a file into another with copy_file_range(),
+   once at explicit offsets and once from and to the file
+   positions, and checks the data, the positions and that an
+   overlapping copy within one file is refused. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE 6000
+
+static char data[SIZE];
+static char back[SIZE];
+
+void
+test_main (void)
+{
+  int src, dst;
+  int i;
+
+  for (i = 0; i < SIZE; i++)
+    data[i] = i % 251;
+
+  CHECK (create ("source", 0), "create \"source\"");
+  CHECK (create ("copy", 0), "create \"copy\"");
+  CHECK ((src = open ("source")) > 1, "open \"source\"");
+  CHECK ((dst = open ("copy")) > 1, "open \"copy\"");
+  CHECK (write (src, data, SIZE) == SIZE, "write %d bytes", SIZE);
+
+  CHECK (copy_file_range (src, 1000, dst, 0, 3000) == 3000,
+         "copy 3000 bytes at explicit offsets");
+  CHECK (tell (src) == SIZE && tell (dst) == 0, "positions unchanged");
+
+  seek (src, 4000);
+  seek (dst, 3000);
+  CHECK (copy_file_range (src, -1, dst, -1, SIZE) == 2000,
+         "copy from position to end of file");
+  CHECK (tell (src) == SIZE && tell (dst) == 5000, "positions advanced");
+
+  CHECK (pread (dst, back, SIZE, 0) == 5000, "read back the copy");
+  if (memcmp (back, data + 1000, 3000)
+      || memcmp (back + 3000, data + 4000, 2000))
+    fail ("copy differs from source");
+
+  CHECK (copy_file_range (src, 0, src, 100, 1000) == -1,
+         "overlapping copy refused");
+
+  close (src);
+  close (dst);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(copy-file-range) begin
+(copy-file-range) create "source"
+(copy-file-range) create "copy"
+(copy-file-range) open "source"
+(copy-file-range) open "copy"
+(copy-file-range) write 6000 bytes
+(copy-file-range) copy 3000 bytes at explicit offsets
+(copy-file-range) positions unchanged
+(copy-file-range) copy from position to end of file
+(copy-file-range) positions advanced
+(copy-file-range) read back the copy
+(copy-file-range) overlapping copy refused
+(copy-file-range) end
+EOF
+pass;
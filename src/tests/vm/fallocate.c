@@ -0,0 +1,55 @@
+/* Reserves space for a file with fallocate(), checks that the
+   file's size does not change, then appends records into the
+   reserved space and past it and reads them back. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define RESERVED (64 * 1024)
+#define RECORD 1000
+#define RECORD_CNT 80
+
+static char record[RECORD];
+
+void
+test_main (void)
+{
+  int fd;
+  int i;
+
+  CHECK (create ("log", 0), "create \"log\"");
+  CHECK ((fd = open ("log")) > 1, "open \"log\"");
+  CHECK (fallocate (fd, 0, RESERVED) == 0, "fallocate %d bytes", RESERVED);
+  CHECK (filesize (fd) == 0, "size is still 0");
+  CHECK (read (fd, record, RECORD) == 0, "read at end of file");
+
+  /* The last records go past the reserved space. */
+  msg ("append %d records", RECORD_CNT);
+  for (i = 0; i < RECORD_CNT; i++)
+    {
+      memset (record, 'a' + i % 26, RECORD);
+      if (write (fd, record, RECORD) != RECORD)
+        fail ("write of record %d failed", i);
+    }
+  CHECK (filesize (fd) == RECORD * RECORD_CNT, "size is %d",
+         RECORD * RECORD_CNT);
+
+  msg ("read records back");
+  seek (fd, 0);
+  for (i = 0; i < RECORD_CNT; i++)
+    {
+      int j;
+      if (read (fd, record, RECORD) != RECORD)
+        fail ("read of record %d failed", i);
+      for (j = 0; j < RECORD; j++)
+        if (record[j] != 'a' + i % 26)
+          fail ("byte %d of record %d is wrong", j, i);
+    }
+
+  CHECK (fallocate (fd, 0, 100) == 0, "fallocate inside the file");
+  CHECK (filesize (fd) == RECORD * RECORD_CNT, "size unchanged");
+  CHECK (fallocate (1, 0, 100) == -1, "fallocate on stdout fails");
+  close (fd);
+}
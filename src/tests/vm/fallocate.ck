@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fallocate) begin
+(fallocate) create "log"
+(fallocate) open "log"
+(fallocate) fallocate 65536 bytes
+(fallocate) size is still 0
+(fallocate) read at end of file
+(fallocate) append 80 records
+(fallocate) size is 80000
+(fallocate) read records back
+(fallocate) fallocate inside the file
+(fallocate) size unchanged
+(fallocate) fallocate on stdout fails
+(fallocate) end
+EOF
+pass;
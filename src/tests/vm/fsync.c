@@ -0,0 +1,63 @@
+/* Writes two files, makes one of them durable with fsync() and
+   then everything with sync(), and checks that neither call
+   changes what the files read back.  Also checks that fsync()
+   refuses descriptors that are not files. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE 6000
+
+static char buf[SIZE];
+static char back[SIZE];
+
+/* Creates NAME, fills it with bytes starting at FIRST and returns
+   its descriptor. */
+static int
+make_file (const char *name, char first)
+{
+  int fd;
+  int i;
+
+  CHECK (create (name, 0), "create \"%s\"", name);
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  for (i = 0; i < SIZE; i++)
+    buf[i] = first + i % 13;
+  CHECK (write (fd, buf, SIZE) == SIZE, "write \"%s\"", name);
+  return fd;
+}
+
+/* Checks that FD holds the bytes make_file() wrote from FIRST. */
+static void
+check_contents (int fd, const char *name, char first)
+{
+  int i;
+
+  CHECK (pread (fd, back, SIZE, 0) == SIZE, "read \"%s\"", name);
+  for (i = 0; i < SIZE; i++)
+    if (back[i] != first + i % 13)
+      fail ("byte %d of \"%s\" is wrong", i, name);
+}
+
+void
+test_main (void)
+{
+  int a = make_file ("a", 'a');
+  int b = make_file ("b", 'A');
+
+  CHECK (fsync (a) == 0, "fsync \"a\"");
+  check_contents (a, "a", 'a');
+  check_contents (b, "b", 'A');
+
+  msg ("sync");
+  sync ();
+  check_contents (a, "a", 'a');
+  check_contents (b, "b", 'A');
+
+  CHECK (fsync (1) == -1, "fsync stdout fails");
+  CHECK (fsync (1234) == -1, "fsync bad fd fails");
+  close (a);
+  close (b);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fsync) begin
+(fsync) create "a"
+(fsync) open "a"
+(fsync) write "a"
+(fsync) create "b"
+(fsync) open "b"
+(fsync) write "b"
+(fsync) fsync "a"
+(fsync) read "a"
+(fsync) read "b"
+(fsync) sync
+(fsync) read "a"
+(fsync) read "b"
+(fsync) fsync stdout fails
+(fsync) fsync bad fd fails
+(fsync) end
+EOF
+pass;
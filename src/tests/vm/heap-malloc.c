@@ -0,0 +1,53 @@
+/* Grows the heap through malloc() past the size of physical
+   memory available to user programs, checks every block, then
+   frees them all and verifies that the heap shrinks back. */
+
+#include <malloc.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_CNT 640
+#define BLOCK_SIZE 8000
+
+static char *blocks[BLOCK_CNT];
+
+void
+test_main (void)
+{
+  char *base = sbrk (0);
+  char *small;
+  size_t i, j;
+
+  CHECK (sbrk (-4096) == (void *) -1, "shrink below heap start fails");
+
+  msg ("realloc");
+  small = malloc (10);
+  strlcpy (small, "heap", 10);
+  small = realloc (small, 3000);
+  if (small == NULL || strcmp (small, "heap"))
+    fail ("realloc lost data");
+  free (small);
+
+  msg ("allocate");
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      blocks[i] = malloc (BLOCK_SIZE);
+      if (blocks[i] == NULL)
+        fail ("malloc of block %zu failed", i);
+      memset (blocks[i], i, BLOCK_SIZE);
+    }
+
+  msg ("check");
+  for (i = 0; i < BLOCK_CNT; i++)
+    for (j = 0; j < BLOCK_SIZE; j++)
+      if (blocks[i][j] != (char) i)
+        fail ("byte %zu of block %zu is %d", j, i, blocks[i][j]);
+
+  msg ("free");
+  for (i = 0; i < BLOCK_CNT; i++)
+    free (blocks[i]);
+
+  CHECK ((char *) sbrk (0) - base <= 4096, "heap shrinks after free");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(heap-malloc) begin
+(heap-malloc) shrink below heap start fails
+(heap-malloc) realloc
+(heap-malloc) allocate
+(heap-malloc) check
+(heap-malloc) free
+(heap-malloc) heap shrinks after free
+(heap-malloc) end
+EOF
+pass;
@@ -0,0 +1,63 @@
+/* Writes a small file a little at a time, so that it starts out
+   with its data in the inode sector, then keeps appending until
+   it needs data sectors of its own and checks that every byte
+   survives the move. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PIECE 60
+#define PIECE_CNT 30
+
+static char piece[PIECE];
+
+/* Returns the byte stored at offset OFS of the file. */
+static char
+byte_at (int ofs)
+{
+  return 'a' + ofs % 23;
+}
+
+void
+test_main (void)
+{
+  int fd;
+  int ofs;
+  int i;
+
+  CHECK (create ("small", 0), "create \"small\"");
+  CHECK ((fd = open ("small")) > 1, "open \"small\"");
+
+  msg ("append %d pieces of %d bytes", PIECE_CNT, PIECE);
+  for (ofs = 0; ofs < PIECE * PIECE_CNT; ofs += PIECE)
+    {
+      for (i = 0; i < PIECE; i++)
+        piece[i] = byte_at (ofs + i);
+      if (write (fd, piece, PIECE) != PIECE)
+        fail ("write at offset %d failed", ofs);
+
+      /* Read the whole file back after every piece. */
+      seek (fd, 0);
+      for (i = 0; i < ofs + PIECE; i++)
+        {
+          char c;
+          if (read (fd, &c, 1) != 1 || c != byte_at (i))
+            fail ("byte %d is wrong after %d bytes written", i, ofs + PIECE);
+        }
+    }
+  CHECK (filesize (fd) == PIECE * PIECE_CNT, "file is %d bytes",
+         PIECE * PIECE_CNT);
+
+  msg ("close \"small\"");
+  close (fd);
+  CHECK ((fd = open ("small")) > 1, "open \"small\" again");
+  for (i = 0; i < PIECE * PIECE_CNT; i++)
+    {
+      char c;
+      if (read (fd, &c, 1) != 1 || c != byte_at (i))
+        fail ("byte %d is wrong after reopening", i);
+    }
+  msg ("read back %d bytes", PIECE * PIECE_CNT);
+  close (fd);
+}
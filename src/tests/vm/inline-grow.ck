@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(inline-grow) begin
+(inline-grow) create "small"
+(inline-grow) open "small"
+(inline-grow) append 30 pieces of 60 bytes
+(inline-grow) file is 1800 bytes
+(inline-grow) close "small"
+(inline-grow) open "small" again
+(inline-grow) read back 1800 bytes
+(inline-grow) end
+EOF
+pass;
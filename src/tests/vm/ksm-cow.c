@@ -0,0 +1,87 @@
+/* Fills several anonymous pages identically and gives the
+   same-page merging scanner time to share them, then writes to
+   the pages one at a time and checks that every write lands in
+   the written page only, so copy-on-write gives each writer a
+   private copy.  Run with -ksm so the pages are merged. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 8
+
+/* Loop iterations that let the scanner make a few passes over
+   the frame table.  User programs have no clock. */
+#define SPIN_LOOPS 20000000
+
+/* Waits for the scanner without touching the pages. */
+static void
+spin (void)
+{
+  volatile int i;
+
+  for (i = 0; i < SPIN_LOOPS; i++)
+    continue;
+}
+
+/* Fills PAGE with a pattern that depends only on SEED. */
+static void
+fill (char *page, int seed)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_SIZE; i++)
+    page[i] = (char) (i * 7 + seed);
+}
+
+/* Fails unless PAGE, page IDX, holds the pattern of SEED. */
+static void
+check (const char *page, size_t idx, int seed)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_SIZE; i++)
+    if (page[i] != (char) (i * 7 + seed))
+      fail ("byte %zu of page %zu is %d, expected %d",
+            i, idx, page[i], (char) (i * 7 + seed));
+}
+
+void
+test_main (void)
+{
+  char *pages = NULL;
+  size_t i, j;
+
+  CHECK (mmap_anon ((void **) &pages, PAGE_CNT * PAGE_SIZE) != MAP_FAILED,
+         "mmap_anon %d pages", PAGE_CNT);
+  for (i = 0; i < PAGE_CNT; i++)
+    fill (pages + i * PAGE_SIZE, 1);
+
+  msg ("wait for merging");
+  spin ();
+  for (i = 0; i < PAGE_CNT; i++)
+    check (pages + i * PAGE_SIZE, i, 1);
+
+  /* Break the sharing one page at a time, letting the scanner
+     run in between so the remaining pages stay merged. */
+  msg ("write each page in turn");
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      fill (pages + i * PAGE_SIZE, 2 + i);
+      for (j = 0; j < PAGE_CNT; j++)
+        check (pages + j * PAGE_SIZE, j, j <= i ? 2 + j : 1);
+      spin ();
+    }
+
+  msg ("write a byte of a merged copy");
+  for (i = 0; i < PAGE_CNT; i++)
+    fill (pages + i * PAGE_SIZE, 1);
+  spin ();
+  pages[PAGE_SIZE / 2] ^= 0x55;
+  for (i = 1; i < PAGE_CNT; i++)
+    check (pages + i * PAGE_SIZE, i, 1);
+  if (pages[PAGE_SIZE / 2] != (char) ((PAGE_SIZE / 2 * 7 + 1) ^ 0x55))
+    fail ("written byte of page 0 is lost");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(ksm-cow) begin
+(ksm-cow) mmap_anon 8 pages
+(ksm-cow) wait for merging
+(ksm-cow) write each page in turn
+(ksm-cow) write a byte of a merged copy
+(ksm-cow) end
+EOF
+pass;
@@ -0,0 +1,52 @@
+/* Maps anonymous memory at a kernel-picked address and at a
+   fixed one, checks that both read back as zeros and hold what
+   is written to them, and that unmapping frees the range. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (1024 * 1024)
+
+static void
+check_zero_then_fill (char *p, size_t size, char c)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != 0)
+      fail ("byte %zu of fresh mapping is %d", i, p[i]);
+  memset (p, c, size);
+  for (i = 0; i < size; i++)
+    if (p[i] != c)
+      fail ("byte %zu of mapping is %d, expected %d", i, p[i], c);
+}
+
+void
+test_main (void)
+{
+  void *picked = NULL;
+  void *fixed = (void *) 0x10000000;
+  void *again;
+  mapid_t map1, map2;
+
+  CHECK ((map1 = mmap_anon (&picked, SIZE)) != MAP_FAILED,
+         "mmap_anon at kernel-picked address");
+  check_zero_then_fill (picked, SIZE, 0x5a);
+
+  CHECK ((map2 = mmap_anon (&fixed, SIZE + 1)) != MAP_FAILED,
+         "mmap_anon at 0x10000000");
+  check_zero_then_fill (fixed, SIZE + 1, 0x3c);
+
+  again = fixed;
+  CHECK (mmap_anon (&again, 1) == MAP_FAILED, "overlapping mmap_anon fails");
+
+  msg ("munmap");
+  munmap (map1);
+  munmap (map2);
+
+  again = fixed;
+  CHECK (mmap_anon (&again, SIZE) != MAP_FAILED, "remap unmapped range");
+  check_zero_then_fill (again, SIZE, 0x11);
+}
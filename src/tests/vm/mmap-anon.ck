@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-anon) begin
+(mmap-anon) mmap_anon at kernel-picked address
+(mmap-anon) mmap_anon at 0x10000000
+(mmap-anon) overlapping mmap_anon fails
+(mmap-anon) munmap
+(mmap-anon) remap unmapped range
+(mmap-anon) end
+EOF
+pass;
@@ -0,0 +1,48 @@
+/* Maps a file, writes to the first page through the mapping and
+   runs child-mm-shared, which maps the same file.  The child must
+   see the write before anything is unmapped or written back, and
+   the parent must see the child's write to the second page through
+   its own mapping.  Then checks that both reach the file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/shared.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[2 * PAGE_SIZE];
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  pid_t child;
+  mapid_t map;
+  int handle;
+  size_t i;
+
+  CHECK (create ("shared", sizeof buf), "create \"shared\"");
+  CHECK ((handle = open ("shared")) > 1, "open \"shared\"");
+  CHECK ((map = mmap (handle, actual)) != MAP_FAILED, "mmap \"shared\"");
+  memset (actual, PARENT_BYTE, PAGE_SIZE);
+
+  quiet = true;
+  CHECK ((child = exec ("child-mm-shared")) != -1,
+         "exec \"child-mm-shared\"");
+  CHECK (wait (child) == 0, "wait for child (should return 0)");
+  quiet = false;
+
+  for (i = 0; i < PAGE_SIZE; i++)
+    if (actual[PAGE_SIZE + i] != CHILD_BYTE)
+      fail ("byte %zu of the child's page is %d", i, actual[PAGE_SIZE + i]);
+  msg ("child's write visible through the mapping");
+
+  munmap (map);
+  CHECK (read (handle, buf, sizeof buf) == (int) sizeof buf,
+         "read \"shared\"");
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != (i < PAGE_SIZE ? PARENT_BYTE : CHILD_BYTE))
+      fail ("byte %zu of \"shared\" is %d", i, buf[i]);
+  msg ("file holds both writes");
+  close (handle);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-shared) begin
+(mmap-shared) create "shared"
+(mmap-shared) open "shared"
+(mmap-shared) mmap "shared"
+(child-mm-shared) begin
+(child-mm-shared) open "shared"
+(child-mm-shared) mmap "shared"
+(child-mm-shared) parent's write visible through the mapping
+(child-mm-shared) end
+(mmap-shared) child's write visible through the mapping
+(mmap-shared) read "shared"
+(mmap-shared) file holds both writes
+(mmap-shared) end
+EOF
+pass;
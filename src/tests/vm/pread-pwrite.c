@@ -0,0 +1,59 @@
+/* Writes and reads records at scattered offsets with pwrite()
+   and pread(), checks that neither moves the file position, and
+   that a pwrite() past the end grows the file with zeros in the
+   gap. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define RECORD 100
+#define RECORD_CNT 20
+
+static char record[RECORD];
+static char back[RECORD];
+
+void
+test_main (void)
+{
+  int fd;
+  int i;
+
+  CHECK (create ("records", RECORD * RECORD_CNT), "create \"records\"");
+  CHECK ((fd = open ("records")) > 1, "open \"records\"");
+
+  msg ("pwrite records in scattered order");
+  for (i = 0; i < RECORD_CNT; i++)
+    {
+      int slot = i * 7 % RECORD_CNT;
+      memset (record, 'A' + slot, RECORD);
+      if (pwrite (fd, record, RECORD, slot * RECORD) != RECORD)
+        fail ("pwrite of record %d failed", slot);
+    }
+  CHECK (tell (fd) == 0, "position unchanged by pwrite");
+
+  msg ("pread records in scattered order");
+  for (i = 0; i < RECORD_CNT; i++)
+    {
+      int slot = i * 13 % RECORD_CNT;
+      int j;
+      if (pread (fd, back, RECORD, slot * RECORD) != RECORD)
+        fail ("pread of record %d failed", slot);
+      for (j = 0; j < RECORD; j++)
+        if (back[j] != 'A' + slot)
+          fail ("byte %d of record %d is wrong", j, slot);
+    }
+  CHECK (tell (fd) == 0, "position unchanged by pread");
+
+  CHECK (pwrite (fd, record, RECORD, 4000) == RECORD, "pwrite past end");
+  CHECK (filesize (fd) == 4000 + RECORD, "file grew to %d bytes",
+         4000 + RECORD);
+  CHECK (pread (fd, back, RECORD, 3000) == RECORD, "pread gap");
+  for (i = 0; i < RECORD; i++)
+    if (back[i] != 0)
+      fail ("byte %d of the gap is %d", i, back[i]);
+  CHECK (pread (fd, back, RECORD, 4050) == RECORD / 2, "pread at end");
+
+  close (fd);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(pread-pwrite) begin
+(pread-pwrite) create "records"
+(pread-pwrite) open "records"
+(pread-pwrite) pwrite records in scattered order
+(pread-pwrite) position unchanged by pwrite
+(pread-pwrite) pread records in scattered order
+(pread-pwrite) position unchanged by pread
+(pread-pwrite) pwrite past end
+(pread-pwrite) file grew to 4100 bytes
+(pread-pwrite) pread gap
+(pread-pwrite) pread at end
+(pread-pwrite) end
+EOF
+pass;
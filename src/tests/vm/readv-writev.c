@@ -0,0 +1,58 @@
+/* Writes a header, a payload and a trailer with one writev(),
+   reads them back into differently sized buffers with one
+   readv(), and checks that both calls move the file position
+   like the equivalent write() and read() calls. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAYLOAD 1500
+
+static char payload[PAYLOAD];
+static char back[PAYLOAD + 16];
+
+void
+test_main (void)
+{
+  char header[] = "HDR:";
+  char trailer[] = ":END";
+  struct iovec out[3];
+  struct iovec in[2];
+  int total = sizeof header - 1 + PAYLOAD + sizeof trailer - 1;
+  int fd;
+  int i;
+
+  for (i = 0; i < PAYLOAD; i++)
+    payload[i] = 'a' + i % 26;
+
+  CHECK (create ("vector", 0), "create \"vector\"");
+  CHECK ((fd = open ("vector")) > 1, "open \"vector\"");
+
+  out[0].iov_base = header;
+  out[0].iov_len = sizeof header - 1;
+  out[1].iov_base = payload;
+  out[1].iov_len = PAYLOAD;
+  out[2].iov_base = trailer;
+  out[2].iov_len = sizeof trailer - 1;
+  CHECK (writev (fd, out, 3) == total, "writev %d bytes", total);
+  CHECK (tell (fd) == (unsigned) total, "position moved past the data");
+  CHECK (filesize (fd) == total, "file is %d bytes", total);
+
+  seek (fd, 0);
+  in[0].iov_base = back;
+  in[0].iov_len = 100;
+  in[1].iov_base = back + 100;
+  in[1].iov_len = sizeof back - 100;
+  CHECK (readv (fd, in, 2) == total, "readv %d bytes", total);
+  if (memcmp (back, header, sizeof header - 1)
+      || memcmp (back + sizeof header - 1, payload, PAYLOAD)
+      || memcmp (back + sizeof header - 1 + PAYLOAD, trailer,
+                 sizeof trailer - 1))
+    fail ("data read back differs from data written");
+  CHECK (readv (fd, in, 2) == 0, "readv at end of file");
+  CHECK (writev (fd, out, 0) == 0, "writev of no buffers");
+
+  close (fd);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(readv-writev) begin
+(readv-writev) create "vector"
+(readv-writev) open "vector"
+(readv-writev) writev 1508 bytes
+(readv-writev) position moved past the data
+(readv-writev) file is 1508 bytes
+(readv-writev) readv 1508 bytes
+(readv-writev) readv at end of file
+(readv-writev) writev of no buffers
+(readv-writev) end
+EOF
+pass;
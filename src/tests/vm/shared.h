@@ -0,0 +1,9 @@
+#ifndef TESTS_VM_SHARED
+#define TESTS_VM_SHARED 1
+
+/* Shared between mmap-shared and child-mm-shared. */
+#define PAGE_SIZE 4096
+#define PARENT_BYTE 'p'
+#define CHILD_BYTE 'c'
+
+#endif /* tests/vm/shared.h */
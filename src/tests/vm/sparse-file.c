@@ -0,0 +1,85 @@
+/* Creates a large file, whose sectors are allocated but never
+   written, and checks that it reads as zeros.  Then writes short
+   records at scattered offsets, some of them across sector
+   boundaries, and checks that they read back with zeros still
+   around them. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (128 * 1024)
+#define RECORD 100
+#define RECORD_CNT 16
+
+static char buf[4096];
+
+/* Returns the offset of record I, 8 KB apart and straddling a
+   sector boundary every other time. */
+static int
+record_ofs (int i)
+{
+  return i * 8192 + (i % 2 ? 512 - RECORD / 2 : 0);
+}
+
+/* Checks that the whole file holds zeros except for the first
+   CNT records, which hold their number. */
+static void
+check_records (int fd, int cnt)
+{
+  int ofs;
+
+  for (ofs = 0; ofs < FILE_SIZE; ofs += sizeof buf)
+    {
+      int i;
+      if (pread (fd, buf, sizeof buf, ofs) != sizeof buf)
+        fail ("pread at offset %d failed", ofs);
+      for (i = 0; i < (int) sizeof buf; i++)
+        {
+          int pos = ofs + i;
+          int rec = pos / 8192;
+          char expected = 0;
+          if (rec < cnt && pos >= record_ofs (rec)
+              && pos < record_ofs (rec) + RECORD)
+            expected = 'A' + rec;
+          if (buf[i] != expected)
+            fail ("byte %d is %d instead of %d", pos, buf[i], expected);
+        }
+    }
+}
+
+void
+test_main (void)
+{
+  char record[RECORD];
+  int fd;
+  int i;
+
+  CHECK (create ("sparse", FILE_SIZE), "create \"sparse\"");
+  CHECK ((fd = open ("sparse")) > 1, "open \"sparse\"");
+  check_records (fd, 0);
+  msg ("new file reads as zeros");
+
+  for (i = RECORD_CNT - 1; i >= 0; i -= 2)
+    {
+      memset (record, 'A' + i, RECORD);
+      if (pwrite (fd, record, RECORD, record_ofs (i)) != RECORD)
+        fail ("pwrite of record %d failed", i);
+    }
+  for (i = 0; i < RECORD_CNT; i += 2)
+    {
+      memset (record, 'A' + i, RECORD);
+      if (pwrite (fd, record, RECORD, record_ofs (i)) != RECORD)
+        fail ("pwrite of record %d failed", i);
+    }
+  msg ("wrote %d records", RECORD_CNT);
+  check_records (fd, RECORD_CNT);
+  msg ("records read back between zeros");
+
+  close (fd);
+  CHECK ((fd = open ("sparse")) > 1, "open \"sparse\" again");
+  check_records (fd, RECORD_CNT);
+  msg ("records survive reopening");
+  close (fd);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sparse-file) begin
+(sparse-file) create "sparse"
+(sparse-file) open "sparse"
+(sparse-file) new file reads as zeros
+(sparse-file) wrote 16 records
+(sparse-file) records read back between zeros
+(sparse-file) open "sparse" again
+(sparse-file) records survive reopening
+(sparse-file) end
+EOF
+pass;
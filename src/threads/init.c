@@ -34,10 +34,16 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
 #ifdef VM
+#include "vm/aio.h"
+#include "vm/frame.h"
+#include "vm/ksm.h"
+#include "vm/pagecache.h"
+#include "vm/prefetch.h"
 #include "vm/swap.h"
 #endif
 
@@ -129,6 +135,13 @@ main (void)
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
+#ifdef VM
+  frame_aging_init ();
+  prefetch_init ();
+  ksm_init ();
+  pcache_init ();
+  aio_init ();
+#endif
 
   printf ("Boot complete.\n");
 
@@ -250,9 +263,15 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-flush"))
+        cache_flush_ms = atoi (value);
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-no-prefetch"))
+        prefetch_enabled = false;
+      else if (!strcmp (name, "-ksm"))
+        ksm_pages_per_sec = atoi (value);
 #endif
 #endif
       else if (!strcmp (name, "-rs"))
@@ -376,8 +395,11 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -flush=MS          Write dirty sectors back after MS ms, 0 at shutdown.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -no-prefetch       Don't prefetch launch profiles at exec.\n"
+          "  -ksm=PAGES         Merge identical pages, scanning PAGES per second.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
@@ -489,6 +489,7 @@ init_thread (struct thread *t, const char *name, int priority)
 #ifdef VM
   t->n_mmap = 0;
   list_init(&t->mmap_desc);
+  t->aio = NULL;
 #endif
   list_push_back (&all_list, &t->allelem);
 }
@@ -117,6 +117,14 @@ struct thread
     void* bottom_of_allocated_stack;
     int n_mmap;
     struct list mmap_desc;
+    void* heap_start;
+    // First byte of the heap, page aligned just above the loaded segments
+    void* heap_break;
+    // Current end of the heap as moved by sbrk()
+    struct launch_profile* launch_record;
+    // Launch profile being recorded for this process, see vm/prefetch.h
+    struct aio_ctx* aio;
+    // Asynchronous I/O rings of this process, NULL until set up, see vm/aio.h
 #endif
 
     /* Owned by thread.c. */
@@ -8,6 +8,8 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "vm/frame.h"
+#include "vm/ksm.h"
 #include "vm/page.h"
 
 // #define DEBUG
@@ -163,6 +165,14 @@ page_fault (struct intr_frame *f)
 #endif
 
   // Virtual memory code
+  // A write to a page merged by the KSM scanner gets its own copy
+  if (!not_present && write && is_user_vaddr(fault_addr)) {
+      struct sup_page_table_entry* shared = get_spte(fault_addr);
+      if (shared != NULL && shared->ksm != NULL && shared->writable
+          && ksm_break_cow(shared))
+          return;
+  }
+
   // First check
   if (!fault_addr || !not_present || !is_user_vaddr(fault_addr)) {
       #ifdef DEBUG
@@ -180,6 +190,8 @@ page_fault (struct intr_frame *f)
   struct sup_page_table_entry* spte = get_spte(fault_addr);
   // Has spte, but needs loading
   if(spte != NULL) {
+      // an eviction of the page has to finish writing it out first
+      frame_wait_evicted(spte);
       if(!spte->is_loaded) page_load(fault_addr);
       return;
   } else {
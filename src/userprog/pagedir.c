@@ -3,6 +3,7 @@
 #include <stddef.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 
@@ -214,6 +215,41 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
     }
 }
 
+/* Calls ACCESSED with the kernel address of every user page in
+   PD that has its accessed bit set and AUX, walking its page
+   tables in order instead of looking each page up, and clears the
+   bit unless ACCESSED returns false.  The TLB is flushed once at
+   the end, not once per page. */
+void
+pagedir_harvest_accessed (uint32_t *pd, pagedir_accessed_func *accessed,
+                          void *aux)
+{
+  uint32_t *pde;
+  bool cleared = false;
+
+  ASSERT (pd != init_page_dir);
+  for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
+    if (*pde & PTE_P)
+      {
+        uint32_t *pt = pde_get_pt (*pde);
+        uint32_t *pte;
+
+        for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
+          if ((*pte & (PTE_P | PTE_A)) == (PTE_P | PTE_A)
+              && accessed (pte_get_page (*pte), aux))
+            {
+              /* Other threads may change the entry meanwhile,
+                 only the accessed bit is cleared. */
+              enum intr_level old_level = intr_disable ();
+              *pte &= ~(uint32_t) PTE_A;
+              intr_set_level (old_level);
+              cleared = true;
+            }
+      }
+  if (cleared)
+    invalidate_pagedir (pd);
+}
+
 /* Loads page directory PD into the CPU's page directory base
    register. */
 void
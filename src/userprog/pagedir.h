@@ -15,4 +15,10 @@ bool pagedir_is_accessed (uint32_t *pd, const void *upage);
 void pagedir_set_accessed (uint32_t *pd, const void *upage, bool accessed);
 void pagedir_activate (uint32_t *pd);
 
+/* Called by pagedir_harvest_accessed() for each accessed page,
+   returns false to leave the page's accessed bit set. */
+typedef bool pagedir_accessed_func (void *kpage, void *aux);
+void pagedir_harvest_accessed (uint32_t *pd, pagedir_accessed_func *,
+                               void *aux);
+
 #endif /* userprog/pagedir.h */
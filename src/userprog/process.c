@@ -19,7 +19,10 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
+#include "vm/aio.h"
+#include "vm/frame.h"
 #include "vm/page.h"
+#include "vm/prefetch.h"
 
 static thread_func start_process NO_RETURN;
 static bool load (struct arguments *args, void (**eip) (void), void **esp);
@@ -180,6 +183,11 @@ process_exit (void)
   uint32_t *pd;
   if(cur->my_exec != NULL) file_close(cur->my_exec);
 
+  #ifdef VM
+    // Requests in flight may still fill in a descriptor
+    aio_exit();
+  #endif
+
   /* Close all opened files */
   for(struct list_elem* iter = list_begin(&cur->file_desc);
       iter != list_end(&cur->file_desc);) {
@@ -190,12 +198,19 @@ process_exit (void)
   }
 
   #ifdef VM
+    // Keep what was recorded of the launch profile
+    prefetch_finish();
     // Unmap all mmap files
     for(struct list_elem* iter = list_begin(&cur->mmap_desc);
         iter != list_end(&cur->mmap_desc);) {
             struct mmap_desc* md = list_entry(iter, struct mmap_desc, elem);
             for (void* i = md->addr; i < md->addr+md->n_pages*PGSIZE; i+=PGSIZE) {
                 struct sup_page_table_entry *spte = get_spte(i);
+                if(md->file == NULL) {
+                    // anonymous mapping
+                    page_release(spte);
+                    continue;
+                }
                 mmap_release_page(i, spte->file, spte->offset, spte->read_bytes);
                 //remove spte from supplementary page table
                 page_delete_spte(spte);
@@ -241,7 +256,7 @@ process_exit (void)
          directory before destroying the process's page
          directory, or our active page directory will be one
          that's been freed (and cleared). */
-      cur->pagedir = NULL;
+      frame_release_pagedir ();
       pagedir_activate (NULL);
       pagedir_destroy (pd);
     }
@@ -345,6 +360,7 @@ load (struct arguments *args, void (**eip) (void), void **esp)
   off_t file_ofs;
   bool success = false;
   int i;
+  uint8_t *heap_start = NULL;
 
   char * exec_name = args->exec_name;
 
@@ -427,6 +443,9 @@ load (struct arguments *args, void (**eip) (void), void **esp)
               if (!load_segment (file, file_page, (void *) mem_page,
                                  read_bytes, zero_bytes, writable))
                 goto done;
+              /* The heap begins right after the highest segment. */
+              if ((uint8_t *) mem_page + read_bytes + zero_bytes > heap_start)
+                heap_start = (uint8_t *) mem_page + read_bytes + zero_bytes;
             }
           else
             goto done;
@@ -442,6 +461,9 @@ load (struct arguments *args, void (**eip) (void), void **esp)
 
   t->my_exec = file;
   file_deny_write(file);
+  t->heap_start = t->heap_break = heap_start;
+  /* Read in the pages earlier runs faulted in right after start. */
+  prefetch_start(file);
   /* Start address. */
   *eip = (void (*) (void)) ehdr.e_entry;
 
@@ -28,7 +28,7 @@ struct file_desc  {
 
 struct mmap_desc {
     int mapid;
-    struct file* file;
+    struct file* file;      // NULL for anonymous mappings
     void* addr;
     int n_pages;
     struct list_elem elem;
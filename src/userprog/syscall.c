@@ -3,17 +3,23 @@
 #include "userprog/process.h"
 #include "userprog/exception.h"
 #include <stdio.h>
+#include <string.h>
+#include <round.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/synch.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "devices/shutdown.h"
 #include "devices/input.h"
+#include "devices/block.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "vm/aio.h"
 #include "vm/page.h"
+#include "vm/pagecache.h"
 
 
 // #define DEBUG
@@ -26,11 +32,11 @@
 
 static void syscall_handler (struct intr_frame *);
 static int fd_alloc(struct file * file);
+static void aio_release_failed(void);
 static int mapid_alloc(struct file * file, void* vaddr, int n_pages);
 static struct file* get_file_from_fd(int fd);
 static struct file_desc* get_fdstruct_from_fd(int fd);
 
-struct lock file_lock;
 struct lock io_lock;
 
 static bool is_valid_user_vaddr(const void* uvaddr, void* esp, bool write) {
@@ -154,7 +160,6 @@ void
 syscall_init (void)
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
-  lock_init(&file_lock);
   lock_init(&io_lock);
 }
 
@@ -260,6 +265,96 @@ syscall_handler (struct intr_frame *f)
             munmap(fd);
             break;
         }
+        case SYS_MMAP_ANON: {
+            void** addrp = (void**)DEREF_BUFFER(f->esp, 4);
+            unsigned length = DEREF_UNSIGNED(f->esp, 5);
+            // the chosen address is written back through addrp
+            if(is_valid_user_vaddr(addrp, f->esp, true) &&
+               is_valid_user_vaddr((void*)addrp + sizeof(void*) - 1, f->esp, true)) {
+                f->eax = mmap_anon(addrp, length);
+            }
+            else exit(-1);
+            break;
+        }
+        case SYS_READV:
+        case SYS_WRITEV: {
+            int fd = DEREF_INT(f->esp, 5);
+            const struct iovec* uiov = (const struct iovec*)DEREF_BUFFER(f->esp, 6);
+            int iovcnt = DEREF_INT(f->esp, 7);
+            bool is_read = DEREF_INT(f->esp, 0) == SYS_READV;
+            struct iovec iov[IOV_MAX];
+            if(iovcnt < 0 || iovcnt > IOV_MAX) {
+                f->eax = -1;
+                break;
+            }
+            // check the array and every buffer once, then work on a kernel copy
+            if(iovcnt > 0 && (!is_valid_user_vaddr(uiov, f->esp, false) ||
+               !is_valid_user_vaddr((void*)(uiov + iovcnt) - 1, f->esp, false))) exit(-1);
+            memcpy(iov, uiov, iovcnt * sizeof(struct iovec));
+            for(int i = 0; i < iovcnt; i++) {
+                void* base = iov[i].iov_base;
+                if(iov[i].iov_len == 0) continue;
+                if(!is_valid_user_vaddr(base, f->esp, is_read) ||
+                   iov[i].iov_len > (size_t)(PHYS_BASE - base) ||
+                   !is_valid_user_vaddr(base + iov[i].iov_len - 1, f->esp, is_read)) exit(-1);
+            }
+            f->eax = is_read ? readv(fd, iov, iovcnt) : writev(fd, iov, iovcnt);
+            break;
+        }
+        case SYS_PREAD:
+        case SYS_PWRITE: {
+            // four arguments reach further up the stack than the check above
+            if(!is_valid_user_vaddr(f->esp+39, f->esp, false)) exit(-1);
+            int fd = DEREF_INT(f->esp, 6);
+            void* buffer = DEREF_BUFFER(f->esp, 7);
+            unsigned size = DEREF_UNSIGNED(f->esp, 8);
+            unsigned offset = DEREF_UNSIGNED(f->esp, 9);
+            bool is_read = DEREF_INT(f->esp, 0) == SYS_PREAD;
+            if(!is_valid_user_vaddr(buffer, f->esp, is_read)) exit(-1);
+            f->eax = is_read ? pread(fd, buffer, size, offset) : pwrite(fd, buffer, size, offset);
+            break;
+        }
+        case SYS_COPY_FILE_RANGE: {
+            if(!is_valid_user_vaddr(f->esp+47, f->esp, false)) exit(-1);
+            int fd_in = DEREF_INT(f->esp, 7);
+            int off_in = DEREF_INT(f->esp, 8);
+            int fd_out = DEREF_INT(f->esp, 9);
+            int off_out = DEREF_INT(f->esp, 10);
+            unsigned size = DEREF_UNSIGNED(f->esp, 11);
+            f->eax = copy_file_range(fd_in, off_in, fd_out, off_out, size);
+            break;
+        }
+        case SYS_FALLOCATE: {
+            int fd = DEREF_INT(f->esp, 5);
+            unsigned offset = DEREF_UNSIGNED(f->esp, 6);
+            unsigned length = DEREF_UNSIGNED(f->esp, 7);
+            f->eax = fallocate(fd, offset, length);
+            break;
+        }
+        case SYS_FSYNC: {
+            int fd = DEREF_INT(f->esp, 1);
+            f->eax = fsync(fd);
+            break;
+        }
+        case SYS_SYNC: {
+            sync();
+            break;
+        }
+        case SYS_AIO_SETUP: {
+            unsigned buf_size = DEREF_UNSIGNED(f->esp, 1);
+            f->eax = (uint32_t) aio_setup(buf_size);
+            break;
+        }
+        case SYS_AIO_ENTER: {
+            unsigned min_complete = DEREF_UNSIGNED(f->esp, 1);
+            f->eax = aio_enter(min_complete);
+            break;
+        }
+        case SYS_SBRK: {
+            int increment = DEREF_INT(f->esp, 1);
+            f->eax = (uint32_t) sbrk(increment);
+            break;
+        }
     }
 
 }
@@ -290,13 +385,18 @@ bool create(const char* file, unsigned initial_size) {
 }
 
 bool remove(const char* file) {
-    return filesys_remove(file);
+    // cached pages keep the inode open, drop them so its sectors are freed
+    struct file *f = filesys_open(file);
+    bool success = filesys_remove(file);
+    if (f != NULL) {
+        if (success) pcache_invalidate(file_get_inode(f));
+        file_close(f);
+    }
+    return success;
 }
 
 int open(const char* file) {
-    lock_acquire(&file_lock);
     struct file *f = filesys_open(file);
-    lock_release(&file_lock);
     if(f != NULL) return fd_alloc(f);
     else return -1;
 }
@@ -325,14 +425,9 @@ int read(int fd, void* buffer, unsigned size) {
     } else  {
         // not stdin
         if (fd == STDOUT_FILENO) return -1;     // cannot read from stdout
-        lock_acquire(&file_lock);
         struct file * f = get_file_from_fd(fd); // get file pointer
-        if (f == NULL) {
-            lock_release(&file_lock);           // release lock before returning
-            return -1;
-        }
-        bytes_read = file_read(f, cbuffer, size);
-        lock_release(&file_lock);
+        if (f == NULL) return -1;
+        bytes_read = pcache_read(f, cbuffer, size);
     }
     return bytes_read;
 }
@@ -348,51 +443,212 @@ int write(int fd, void* buffer, unsigned size) {
     } else {
         // not stdout
         if (fd == STDIN_FILENO) return -1;      // cannot write to stdin
-        lock_acquire(&file_lock);
         struct file * f = get_file_from_fd(fd); // get file pointer
-        if (f == NULL || f->deny_write == true) {
-            lock_release(&file_lock);           // release lock before returning
-            return -1;
-        }
-        bytes_written = file_write(f, buffer, size);
-        lock_release(&file_lock);
+        if (f == NULL || f->deny_write == true) return -1;
+        bytes_written = pcache_write(f, buffer, size);
     }
     return bytes_written;
 }
 
+int readv(int fd, const struct iovec* iov, int iovcnt) {
+    int total = 0;
+    if(fd == STDIN_FILENO) {
+        for(int i = 0; i < iovcnt; i++) {
+            int n = read(fd, iov[i].iov_base, iov[i].iov_len);
+            total += n;
+            if((size_t) n < iov[i].iov_len) break;
+        }
+        return total;
+    }
+    if(fd == STDOUT_FILENO) return -1;
+    // one descriptor lookup for the whole call, the page cache copies into
+    // each buffer directly
+    struct file* f = get_file_from_fd(fd);
+    if(f == NULL) return -1;
+    for(int i = 0; i < iovcnt; i++) {
+        off_t n = pcache_read(f, iov[i].iov_base, iov[i].iov_len);
+        total += n;
+        if((size_t) n < iov[i].iov_len) break;
+    }
+    return total;
+}
+
+/* Writes the LEN bytes gathered in BOUNCE to F. */
+static bool writev_flush(struct file* f, const void* bounce, size_t len, int* total) {
+    off_t n = pcache_write(f, bounce, len);
+    *total += n;
+    return (size_t) n == len;
+}
+
+int writev(int fd, const struct iovec* iov, int iovcnt) {
+    int total = 0;
+    if(fd == STDOUT_FILENO) {
+        // one hold of the console lock keeps the pieces together
+        lock_acquire(&io_lock);
+        for(int i = 0; i < iovcnt; i++) {
+            putbuf(iov[i].iov_base, iov[i].iov_len);
+            total += iov[i].iov_len;
+        }
+        lock_release(&io_lock);
+        return total;
+    }
+    if(fd == STDIN_FILENO) return -1;
+    struct file* f = get_file_from_fd(fd);
+    if(f == NULL || f->deny_write == true) return -1;
+
+    // Small buffers are gathered into a page and written together. The
+    // first flush ends on a sector boundary, so the ones after it cover
+    // whole sectors and the buffer cache does not read them first.
+    uint8_t* bounce = palloc_get_page(0);
+    if(bounce == NULL) {
+        for(int i = 0; i < iovcnt; i++) {
+            off_t n = pcache_write(f, iov[i].iov_base, iov[i].iov_len);
+            total += n;
+            if((size_t) n < iov[i].iov_len) break;
+        }
+        return total;
+    }
+    size_t limit = PGSIZE - file_tell(f) % BLOCK_SECTOR_SIZE;
+    size_t used = 0;
+    bool ok = true;
+    for(int i = 0; ok && i < iovcnt; i++) {
+        const uint8_t* p = iov[i].iov_base;
+        size_t left = iov[i].iov_len;
+        while(ok && left > 0) {
+            if(used == 0 && left >= limit) {
+                // a big buffer goes straight to the file, whole pages of it
+                size_t chunk = left - (left - limit) % PGSIZE;
+                ok = writev_flush(f, p, chunk, &total);
+                p += chunk;
+                left -= chunk;
+                limit = PGSIZE;
+                continue;
+            }
+            size_t chunk = left < limit - used ? left : limit - used;
+            memcpy(bounce + used, p, chunk);
+            used += chunk;
+            p += chunk;
+            left -= chunk;
+            if(used == limit) {
+                ok = writev_flush(f, bounce, used, &total);
+                used = 0;
+                limit = PGSIZE;
+            }
+        }
+    }
+    if(ok && used > 0) writev_flush(f, bounce, used, &total);
+    palloc_free_page(bounce);
+    return total;
+}
+
+// positional I/O leaves the file position alone, so processes sharing a
+// file never race between a seek and the read or write after it
+int pread(int fd, void* buffer, unsigned size, unsigned offset) {
+    if(fd == STDIN_FILENO || fd == STDOUT_FILENO) return -1;  // not seekable
+    if(offset > INT32_MAX || size > INT32_MAX - offset) return -1;
+    struct file* f = get_file_from_fd(fd);
+    if(f == NULL) return -1;
+    return pcache_read_at(file_get_inode(f), buffer, size, offset);
+}
+
+int pwrite(int fd, void* buffer, unsigned size, unsigned offset) {
+    if(fd == STDIN_FILENO || fd == STDOUT_FILENO) return -1;  // not seekable
+    if(offset > INT32_MAX || size > INT32_MAX - offset) return -1;
+    struct file* f = get_file_from_fd(fd);
+    if(f == NULL || f->deny_write == true) return -1;
+    return pcache_write_at(f, buffer, size, offset);
+}
+
+// copy SIZE bytes between two files without a trip through user memory,
+// an offset of -1 stands for the file's position, which is then advanced
+int copy_file_range(int fd_in, int off_in, int fd_out, int off_out, unsigned size) {
+    struct file* in = get_file_from_fd(fd_in);
+    struct file* out = get_file_from_fd(fd_out);
+    if(in == NULL || out == NULL || out->deny_write == true) return -1;
+    off_t pos_in = off_in == -1 ? file_tell(in) : off_in;
+    off_t pos_out = off_out == -1 ? file_tell(out) : off_out;
+    if(pos_in < 0 || pos_out < 0) return -1;
+    if(size > (unsigned)(INT32_MAX - pos_in) || size > (unsigned)(INT32_MAX - pos_out)) return -1;
+    struct inode* inode_in = file_get_inode(in);
+    // overlapping ranges of one file would read back what was just written
+    if(inode_in == file_get_inode(out) && pos_in < pos_out + (off_t) size
+       && pos_out < pos_in + (off_t) size) return -1;
+    uint8_t* buf = palloc_get_page(0);
+    if(buf == NULL) return -1;
+
+    // the first chunk ends the output on a sector boundary and the others
+    // are whole pages, so the buffer cache never reads a sector to patch it
+    int total = 0;
+    off_t chunk = PGSIZE - pos_out % BLOCK_SECTOR_SIZE;
+    while(size > 0) {
+        if((unsigned) chunk > size) chunk = size;
+        off_t n = pcache_read_at(inode_in, buf, chunk, pos_in);
+        if(n <= 0) break;
+        off_t written = pcache_write_at(out, buf, n, pos_out);
+        total += written;
+        pos_in += written;
+        pos_out += written;
+        size -= written;
+        if(written < n || n < chunk) break;
+        chunk = PGSIZE;
+    }
+    palloc_free_page(buf);
+    if(off_in == -1) file_seek(in, pos_in);
+    if(off_out == -1) file_seek(out, pos_out);
+    return total;
+}
+
+// reserve the sectors of a range of the file without writing them or
+// changing its size, so later writes there find their space allocated
+int fallocate(int fd, unsigned offset, unsigned length) {
+    if(fd == STDIN_FILENO || fd == STDOUT_FILENO) return -1;
+    if(offset > INT32_MAX || length > INT32_MAX - offset) return -1;
+    struct file* f = get_file_from_fd(fd);
+    if(f == NULL || f->deny_write == true) return -1;
+    return inode_allocate(file_get_inode(f), offset, length) ? 0 : -1;
+}
+
+// make one file's data durable without writing back everybody else's
+int fsync(int fd) {
+    if(fd == STDIN_FILENO || fd == STDOUT_FILENO) return -1;
+    struct file* f = get_file_from_fd(fd);
+    if(f == NULL) return -1;
+    // what mappings wrote goes to the file first
+    bool ok = pcache_sync(file_get_inode(f));
+    filesys_fsync(f);
+    return ok ? 0 : -1;
+}
+
+void sync(void) {
+    pcache_sync(NULL);
+    filesys_sync();
+}
+
 void seek(int fd, unsigned position) {
-    lock_acquire(&file_lock);
     struct file * f = get_file_from_fd(fd); // get file pointer
-    if (f == NULL) {
-        lock_release(&file_lock);           // release lock before returning
-        return;
-    }
+    if (f == NULL) return;
     file_seek(f, position);
-    lock_release(&file_lock);
 }
 
 unsigned tell(int fd) {
-    lock_acquire(&file_lock);
     struct file * f = get_file_from_fd(fd); // get file pointer
-    if (f == NULL) {
-        lock_release(&file_lock);           // release lock before returning
-        return 0;
-    }
-    unsigned position = file_tell(f);
-    lock_release(&file_lock);
-    return position;
+    if (f == NULL) return 0;
+    return file_tell(f);
 }
 
 void close(int fd) {
-    lock_acquire(&file_lock);
     struct file_desc * target_file = get_fdstruct_from_fd(fd); // get file_desc pointer
-    if (target_file == NULL) {
-        lock_release(&file_lock);           // release lock before returning
-        return;
+    if (target_file == NULL) return;
+    // an asynchronous open may still store its file in the descriptor,
+    // wait for it, a failed one gives its descriptor back
+    if (target_file->file == NULL) {
+        aio_drain();
+        aio_release_failed();
+        target_file = get_fdstruct_from_fd(fd);
+        if (target_file == NULL) return;
     }
     file_close(target_file->file);
     fd_dealloc(target_file);
-    lock_release(&file_lock);
 }
 
 int mmap(int fd, void* addr) {
@@ -427,11 +683,69 @@ int mmap(int fd, void* addr) {
     return mapid;
 }
 
+/* Finds N_PAGES unused pages for an anonymous mapping, searching down
+   from the lowest possible stack page towards the heap. */
+static void* mmap_pick_addr(int n_pages) {
+    struct thread* t = thread_current();
+    void* end = PHYS_BASE - MAX_STACK_SIZE;
+    void* floor = pg_round_up(t->heap_break);
+    if(floor < (void*)PGSIZE) floor = (void*)PGSIZE;
+    while(end - floor >= n_pages*PGSIZE) {
+        void* start = end - n_pages*PGSIZE;
+        void* i;
+        for(i = end - PGSIZE; i >= start; i -= PGSIZE) {
+            if(get_spte(i) != NULL) break;
+        }
+        if(i < start) return start;
+        // retry right below the page that is in use
+        end = i;
+    }
+    return NULL;
+}
+
+int mmap_anon(void** addrp, unsigned length) {
+    void* addr = *addrp;
+    if(length == 0 || length > (uintptr_t)PHYS_BASE) return -1;
+    int n_pages = DIV_ROUND_UP(length, PGSIZE);
+    void* i;
+    if(addr == NULL) {
+        // let the kernel pick
+        addr = mmap_pick_addr(n_pages);
+        if(addr == NULL) return -1;
+    }
+    else {
+        // page aligned and inside user space?
+        if(addr != pg_round_down(addr) || addr >= PHYS_BASE) return -1;
+        if((PHYS_BASE - addr)/PGSIZE < n_pages) return -1;
+        // overlaped?
+        for(i=addr;i<addr+n_pages*PGSIZE;i+=PGSIZE) {
+            if(get_spte(i) != NULL) return -1;
+        }
+    }
+    // Pages are demand-zero and swap backed once dirty
+    for(i=addr;i<addr+n_pages*PGSIZE;i+=PGSIZE) {
+        if(!page_grow_zero(i, true)) {
+            while(i > addr) {
+                i -= PGSIZE;
+                page_release(get_spte(i));
+            }
+            return -1;
+        }
+    }
+    *addrp = addr;
+    return mapid_alloc(NULL, addr, n_pages);
+}
+
 void munmap(int mapid) {
     struct mmap_desc *md = get_mdstruct_from_md(mapid);
     if(md == NULL) return;
     for (void* i = md->addr; i < md->addr+md->n_pages*PGSIZE; i+=PGSIZE) {
         struct sup_page_table_entry *spte = get_spte(i);
+        if(md->file == NULL) {
+            // anonymous mapping, nothing to write back
+            page_release(spte);
+            continue;
+        }
         mmap_release_page(i, spte->file, spte->offset, spte->read_bytes);
         //remove spte from supplementary page table
         page_delete_spte(spte);
@@ -439,3 +753,123 @@ void munmap(int mapid) {
     file_close(md->file);
     md_dealloc(md);
 }
+
+void* sbrk(int increment) {
+    struct thread* t = thread_current();
+    void* old_break = t->heap_break;
+    void* new_break = old_break + increment;
+    if(increment == 0) return old_break;
+    // the heap may neither shrink below its start nor grow into the stack
+    if(increment > 0 && (new_break < old_break || new_break > PHYS_BASE - MAX_STACK_SIZE))
+        return (void*)-1;
+    if(increment < 0 && (new_break > old_break || new_break < t->heap_start))
+        return (void*)-1;
+    void* old_top = pg_round_up(old_break);
+    void* new_top = pg_round_up(new_break);
+    void* i;
+    if(new_top > old_top) {
+        // overlaped?
+        for(i=old_top; i<new_top; i+=PGSIZE) {
+            if(get_spte(i) != NULL) return (void*)-1;
+        }
+        // new heap pages are demand-zero, no frame is used until first touched
+        for(i=old_top; i<new_top; i+=PGSIZE) {
+            if(!page_grow_zero(i, true)) {
+                while(i > old_top) {
+                    i -= PGSIZE;
+                    page_release(get_spte(i));
+                }
+                return (void*)-1;
+            }
+        }
+    }
+    else {
+        // give back every page that is entirely above the new break
+        for(i=new_top; i<old_top; i+=PGSIZE) {
+            struct sup_page_table_entry *spte = get_spte(i);
+            if(spte != NULL) page_release(spte);
+        }
+    }
+    t->heap_break = new_break;
+    return old_break;
+}
+
+// map the rings and BUF_SIZE bytes of buffer area for asynchronous I/O into
+// the process, returns the ring or NULL if the process has one already
+void* aio_setup(unsigned buf_size) {
+    if(thread_current()->aio != NULL || buf_size > AIO_BUF_MAX) return NULL;
+    void* addr = mmap_pick_addr(1 + DIV_ROUND_UP(buf_size, PGSIZE));
+    if(addr == NULL || !aio_create(addr, buf_size)) return NULL;
+    return addr;
+}
+
+// turn a submission entry into a request for the workers, resolving the
+// descriptor and the buffer while still in the process, NULL if it is invalid
+static struct aio_request* aio_prepare(const struct aio_sqe* sqe) {
+    struct aio_request* req = malloc(sizeof(struct aio_request));
+    if(req == NULL) return NULL;
+    req->op = sqe->op;
+    req->file = NULL;
+    req->fd = NULL;
+    req->name = NULL;
+    req->kbuf = NULL;
+    req->len = sqe->len;
+    req->offset = sqe->offset;
+    req->user_data = sqe->user_data;
+
+    if(sqe->op == AIO_OPEN) {
+        // the name has to end inside the buffer area, the process may still
+        // change it there so the worker gets a copy
+        const char* name = aio_buffer(sqe->buf, sqe->len);
+        size_t n = name != NULL ? strnlen(name, sqe->len) : 0;
+        if(name == NULL || n == sqe->len || (req->name = malloc(n + 1)) == NULL) {
+            free(req);
+            return NULL;
+        }
+        memcpy(req->name, name, n);
+        req->name[n] = '\0';
+        // reserve the descriptor now, its file stays NULL until the open is done
+        req->fd = get_fdstruct_from_fd(fd_alloc(NULL));
+        return req;
+    }
+
+    struct file* f = NULL;
+    if(sqe->fd != STDIN_FILENO && sqe->fd != STDOUT_FILENO) f = get_file_from_fd(sqe->fd);
+    bool ok = f != NULL;
+    if(ok && sqe->op == AIO_WRITE && f->deny_write) ok = false;
+    if(ok && (sqe->op == AIO_READ || sqe->op == AIO_WRITE)) {
+        ok = sqe->offset <= INT32_MAX && sqe->len <= INT32_MAX - sqe->offset
+             && (req->kbuf = aio_buffer(sqe->buf, sqe->len)) != NULL;
+    }
+    else if(ok && sqe->op != AIO_FSYNC) ok = false;
+    // a private handle keeps the file open if the process closes the fd meanwhile
+    if(ok) ok = (req->file = file_reopen(f)) != NULL;
+    if(!ok) {
+        free(req);
+        return NULL;
+    }
+    return req;
+}
+
+// free the descriptors reserved by asynchronous opens that failed
+static void aio_release_failed(void) {
+    struct file_desc* target_file;
+    while((target_file = aio_failed_open()) != NULL) fd_dealloc(target_file);
+}
+
+// hand every filled submission entry to the workers, then wait until
+// MIN_COMPLETE completions are there to reap, returns the entries taken
+int aio_enter(unsigned min_complete) {
+    if(thread_current()->aio == NULL) return -1;
+    aio_release_failed();
+    struct aio_sqe sqe;
+    int taken = 0;
+    while(aio_next_sqe(&sqe)) {
+        struct aio_request* req = aio_prepare(&sqe);
+        if(req != NULL) aio_submit(req);
+        else aio_complete_now(sqe.user_data, -1);
+        taken++;
+    }
+    aio_wait(min_complete);
+    return taken;
+}
@@ -4,9 +4,15 @@
 #include "threads/thread.h"
 #include "threads/synch.h"
 
-extern struct lock file_lock;
 extern struct lock io_lock;
 
+// One buffer of readv/writev, the same layout as in lib/user/syscall.h
+struct iovec {
+    void* iov_base;
+    size_t iov_len;
+};
+#define IOV_MAX 64
+
 void syscall_init (void);
 
 void halt(void);
@@ -24,5 +30,17 @@ unsigned tell(int fd);
 void close(int fd);
 int mmap(int fd, void* addr);
 void munmap(int mapid);
+void* sbrk(int increment);
+int mmap_anon(void** addrp, unsigned length);
+int readv(int fd, const struct iovec* iov, int iovcnt);
+int writev(int fd, const struct iovec* iov, int iovcnt);
+int pread(int fd, void* buffer, unsigned size, unsigned offset);
+int pwrite(int fd, void* buffer, unsigned size, unsigned offset);
+int copy_file_range(int fd_in, int off_in, int fd_out, int off_out, unsigned size);
+int fallocate(int fd, unsigned offset, unsigned length);
+int fsync(int fd);
+void sync(void);
+void* aio_setup(unsigned buf_size);
+int aio_enter(unsigned min_complete);
 
 #endif /* userprog/syscall.h */
@@ -0,0 +1,299 @@
+#include "vm/aio.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "vm/page.h"
+#include "vm/pagecache.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+
+/*The kernel side of a process's rings. The ring page is shared with the
+process, so the kernel keeps its own copy of the indexes it owns and only
+publishes them there. LOCK protects the indexes and IN_FLIGHT*/
+struct aio_ctx {
+	struct aio_ring *ring;
+	// Kernel address of the ring page, the buffer area follows it
+	void *uaddr;
+	// User address of the ring page
+	size_t page_cnt;
+	// Ring page plus buffer area pages
+	unsigned buf_size;
+	// Size of the buffer area, the copy in the ring is only for the process
+	unsigned sq_head;
+	unsigned cq_tail;
+	int in_flight;
+	// Requests taken from the ring that have not completed yet
+	struct list failed_opens;
+	// Opens that failed, their reserved descriptors are still to be freed
+	struct lock lock;
+	struct condition done;
+	// Signaled for every completion
+};
+
+static struct list queue;
+/*Requests waiting for a worker, oldest first*/
+static struct lock queue_lock;
+static struct condition queue_cond;
+
+static long long request_cnt, enter_cnt;
+
+static thread_func aio_worker NO_RETURN;
+
+/*Function to start the worker threads*/
+void aio_init (void){
+	int i;
+	list_init(&queue);
+	lock_init(&queue_lock);
+	cond_init(&queue_cond);
+	for (i = 0; i < AIO_WORKERS; i++){
+		char name[16];
+		snprintf(name, sizeof name, "aio%d", i);
+		thread_create(name, PRI_DEFAULT, aio_worker, NULL);
+	}
+}
+
+/*Function to give the current process a ring page and BUF_SIZE bytes of
+buffer area, mapped at UADDR, where the caller has checked that 1 +
+DIV_ROUND_UP(BUF_SIZE, PGSIZE) pages are unused. The pages come from the
+kernel pool so the workers reach them without the process's page table*/
+bool aio_create (void *uaddr, unsigned buf_size){
+	struct thread *t = thread_current();
+	if (t->aio != NULL || buf_size > AIO_BUF_MAX)
+		return false;
+	size_t page_cnt = 1 + DIV_ROUND_UP(buf_size, PGSIZE);
+	struct aio_ctx *ctx = malloc(sizeof(struct aio_ctx));
+	if (ctx == NULL)
+		return false;
+	uint8_t *kpages = palloc_get_multiple(PAL_ZERO, page_cnt);
+	if (kpages == NULL){
+		free(ctx);
+		return false;
+	}
+	size_t i;
+	for (i = 0; i < page_cnt; i++){
+		if (!page_grow_aio((uint8_t *) uaddr + i * PGSIZE, kpages + i * PGSIZE)){
+			while (i-- > 0){
+				void *upage = (uint8_t *) uaddr + i * PGSIZE;
+				pagedir_clear_page(t->pagedir, upage);
+				page_delete_spte(get_spte(upage));
+			}
+			palloc_free_multiple(kpages, page_cnt);
+			free(ctx);
+			return false;
+		}
+	}
+	ctx->ring = (struct aio_ring *) kpages;
+	ctx->uaddr = uaddr;
+	ctx->page_cnt = page_cnt;
+	ctx->buf_size = buf_size;
+	ctx->sq_head = 0;
+	ctx->cq_tail = 0;
+	ctx->in_flight = 0;
+	list_init(&ctx->failed_opens);
+	lock_init(&ctx->lock);
+	cond_init(&ctx->done);
+	ctx->ring->buf = buf_size > 0 ? (uint8_t *) uaddr + PGSIZE : NULL;
+	ctx->ring->buf_size = buf_size;
+	t->aio = ctx;
+	return true;
+}
+
+/*Function to take the next submission of the current process into *SQE.
+Returns false if the ring is empty, or if the completion ring could not
+take one more completion, the entry then stays for the next call*/
+bool aio_next_sqe (struct aio_sqe *sqe){
+	struct aio_ctx *ctx = thread_current()->aio;
+	struct aio_ring *ring = ctx->ring;
+	bool taken = false;
+
+	lock_acquire(&ctx->lock);
+	unsigned pending = ring->sq_tail - ctx->sq_head;
+	//A completion slot is kept for every request in flight
+	unsigned unreaped = ctx->cq_tail - ring->cq_head;
+	if (unreaped > AIO_ENTRIES)
+		unreaped = AIO_ENTRIES;
+	if (pending > 0 && pending <= AIO_ENTRIES
+	    && unreaped + ctx->in_flight < AIO_ENTRIES){
+		*sqe = ring->sq[ctx->sq_head % AIO_ENTRIES];
+		ring->sq_head = ++ctx->sq_head;
+		ctx->in_flight++;
+		request_cnt++;
+		taken = true;
+	}
+	lock_release(&ctx->lock);
+	return taken;
+}
+
+/*Function to translate LEN bytes at UBUF in the current process's buffer
+area to the kernel address the workers use. Returns NULL if any of them lie
+outside the area*/
+void *aio_buffer (const void *ubuf, unsigned len){
+	struct aio_ctx *ctx = thread_current()->aio;
+	const uint8_t *start = (const uint8_t *) ctx->uaddr + PGSIZE;
+	size_t size = ctx->buf_size;
+	if ((const uint8_t *) ubuf < start || (size_t) ((const uint8_t *) ubuf - start) > size
+	    || len > size - ((const uint8_t *) ubuf - start))
+		return NULL;
+	return (uint8_t *) ctx->ring + PGSIZE + ((const uint8_t *) ubuf - start);
+}
+
+/*Function to post a completion of CTX and drop the request from the
+requests in flight. A failed open, REQ, is kept for aio_failed_open()*/
+static void aio_post (struct aio_ctx *ctx, struct aio_request *req, unsigned user_data, int result){
+	lock_acquire(&ctx->lock);
+	if (req != NULL)
+		list_push_back(&ctx->failed_opens, &req->elem);
+	struct aio_cqe *cqe = &ctx->ring->cq[ctx->cq_tail % AIO_ENTRIES];
+	cqe->user_data = user_data;
+	cqe->result = result;
+	//The process may reap the entry as soon as it sees the new tail
+	barrier();
+	ctx->ring->cq_tail = ++ctx->cq_tail;
+	ctx->in_flight--;
+	cond_broadcast(&ctx->done, &ctx->lock);
+	lock_release(&ctx->lock);
+}
+
+/*Function to complete a submission taken by aio_next_sqe() right away,
+for entries that are rejected before reaching a worker*/
+void aio_complete_now (unsigned user_data, int result){
+	aio_post(thread_current()->aio, NULL, user_data, result);
+}
+
+/*Function to hand REQ, built from a submission taken by aio_next_sqe(), to
+the workers*/
+void aio_submit (struct aio_request *req){
+	req->ctx = thread_current()->aio;
+	lock_acquire(&queue_lock);
+	list_push_back(&queue, &req->elem);
+	cond_signal(&queue_cond, &queue_lock);
+	lock_release(&queue_lock);
+}
+
+/*Function to block until the current process has MIN_COMPLETE unreaped
+completions, or nothing left in flight that could add one*/
+void aio_wait (unsigned min_complete){
+	struct aio_ctx *ctx = thread_current()->aio;
+	lock_acquire(&ctx->lock);
+	enter_cnt++;
+	while (ctx->cq_tail - ctx->ring->cq_head < min_complete && ctx->in_flight > 0)
+		cond_wait(&ctx->done, &ctx->lock);
+	lock_release(&ctx->lock);
+}
+
+/*Function to carry out REQ and return its result*/
+static int aio_run (struct aio_request *req){
+	int result = -1;
+	switch (req->op){
+		case AIO_READ:
+			result = pcache_read_at(file_get_inode(req->file), req->kbuf, req->len, req->offset);
+			break;
+		case AIO_WRITE:
+			result = pcache_write_at(req->file, req->kbuf, req->len, req->offset);
+			break;
+		case AIO_FSYNC:
+			result = pcache_sync(file_get_inode(req->file)) ? 0 : -1;
+			filesys_fsync(req->file);
+			break;
+		case AIO_OPEN: {
+			//The descriptor reads as closed until the file is stored in it
+			struct file *f = filesys_open(req->name);
+			if (f != NULL){
+				req->fd->file = f;
+				result = req->fd->fd_number;
+			}
+			free(req->name);
+			break;
+		}
+		default:
+			NOT_REACHED();
+	}
+	file_close(req->file);
+	return result;
+}
+
+/*A worker thread, carries out queued requests in order*/
+static void aio_worker (void *aux UNUSED){
+	for (;;){
+		lock_acquire(&queue_lock);
+		while (list_empty(&queue))
+			cond_wait(&queue_cond, &queue_lock);
+		struct aio_request *req = list_entry(list_pop_front(&queue), struct aio_request, elem);
+		lock_release(&queue_lock);
+
+		int result = aio_run(req);
+		if (req->op == AIO_OPEN && result < 0)
+			aio_post(req->ctx, req, req->user_data, result);
+		else {
+			aio_post(req->ctx, NULL, req->user_data, result);
+			free(req);
+		}
+	}
+}
+
+/*Function to wait until nothing of the current process is in flight, so
+every descriptor reserved by an open holds its file or is a failed one*/
+void aio_drain (void){
+	struct aio_ctx *ctx = thread_current()->aio;
+	if (ctx == NULL)
+		return;
+	lock_acquire(&ctx->lock);
+	while (ctx->in_flight > 0)
+		cond_wait(&ctx->done, &ctx->lock);
+	lock_release(&ctx->lock);
+}
+
+/*Function to return the descriptor reserved by an open of the current
+process that failed, for the caller to free, or NULL if there is none*/
+struct file_desc *aio_failed_open (void){
+	struct aio_ctx *ctx = thread_current()->aio;
+	struct aio_request *req = NULL;
+	if (ctx == NULL)
+		return NULL;
+	lock_acquire(&ctx->lock);
+	if (!list_empty(&ctx->failed_opens))
+		req = list_entry(list_pop_front(&ctx->failed_opens), struct aio_request, elem);
+	lock_release(&ctx->lock);
+	if (req == NULL)
+		return NULL;
+	struct file_desc *fd = req->fd;
+	free(req);
+	return fd;
+}
+
+/*Function to tear down the current process's rings, called when it exits
+before its descriptors are closed. Waits for the requests in flight, which
+may still store an opened file in a descriptor, descriptors of failed
+opens are closed with the others*/
+void aio_exit (void){
+	struct thread *t = thread_current();
+	struct aio_ctx *ctx = t->aio;
+	if (ctx == NULL)
+		return;
+	aio_drain();
+	//The descriptors themselves go with the process's other ones
+	while (!list_empty(&ctx->failed_opens))
+		free(list_entry(list_pop_front(&ctx->failed_opens), struct aio_request, elem));
+
+	size_t i;
+	for (i = 0; i < ctx->page_cnt; i++){
+		void *upage = (uint8_t *) ctx->uaddr + i * PGSIZE;
+		pagedir_clear_page(t->pagedir, upage);
+		page_delete_spte(get_spte(upage));
+	}
+	palloc_free_multiple(ctx->ring, ctx->page_cnt);
+	free(ctx);
+	t->aio = NULL;
+}
+
+/*Prints asynchronous I/O statistics*/
+void aio_print_stats (void){
+	printf("AIO: %lld requests, %lld aio_enter calls\n", request_cnt, enter_cnt);
+}
@@ -0,0 +1,96 @@
+#ifndef VM_AIO_H
+#define VM_AIO_H
+
+#include <stdbool.h>
+#include <list.h>
+#include "filesys/file.h"
+
+/*Asynchronous I/O: a process shares a page holding a submission ring and a
+completion ring, and a buffer area behind it, with the kernel. The process
+fills submission entries and hands all of them over with one aio_enter()
+call, kernel worker threads carry them out and post completions the process
+reaps straight from the ring. The layout must match lib/user/syscall.h*/
+
+#define AIO_ENTRIES 64
+//Entries of each ring, also the most requests in flight per process
+#define AIO_BUF_MAX (16 * 4096)
+//Largest buffer area a process can ask for
+#define AIO_WORKERS 4
+//Kernel threads carrying out requests
+
+#define AIO_READ 0
+#define AIO_WRITE 1
+#define AIO_FSYNC 2
+#define AIO_OPEN 3
+
+struct aio_sqe {
+	int op;
+	// AIO_READ, AIO_WRITE, AIO_FSYNC or AIO_OPEN
+	int fd;
+	// File to work on, unused by AIO_OPEN
+	void *buf;
+	// Data, or the name to open, inside the buffer area
+	unsigned len;
+	// Bytes to read or write
+	unsigned offset;
+	// File offset to read or write at
+	unsigned user_data;
+	// Handed back in the completion
+};
+
+struct aio_cqe {
+	unsigned user_data;
+	int result;
+	// Bytes read or written, 0 for fsync, the new fd for open, -1 on error
+};
+
+struct aio_ring {
+	volatile unsigned sq_head;
+	// Submissions taken by the kernel, written by the kernel only
+	volatile unsigned sq_tail;
+	// Submissions filled in by the process
+	volatile unsigned cq_head;
+	// Completions reaped by the process
+	volatile unsigned cq_tail;
+	// Completions posted, written by the kernel only
+	void *buf;
+	// User address of the buffer area
+	unsigned buf_size;
+	struct aio_sqe sq[AIO_ENTRIES];
+	struct aio_cqe cq[AIO_ENTRIES];
+	// Entry I of a ring lives in slot I % AIO_ENTRIES
+};
+
+struct file_desc;
+
+/*A request on its way to a worker*/
+struct aio_request {
+	int op;
+	struct file *file;
+	// Private handle for read, write and fsync, closed when done
+	struct file_desc *fd;
+	// Descriptor reserved for open, the file goes in once it is open
+	char *name;
+	// Kernel copy of the name to open
+	void *kbuf;
+	// Kernel address of the data in the buffer area
+	unsigned len;
+	unsigned offset;
+	unsigned user_data;
+	struct aio_ctx *ctx;
+	struct list_elem elem;
+};
+
+void aio_init (void);
+bool aio_create (void *uaddr, unsigned buf_size);
+bool aio_next_sqe (struct aio_sqe *sqe);
+void *aio_buffer (const void *ubuf, unsigned len);
+void aio_submit (struct aio_request *req);
+void aio_complete_now (unsigned user_data, int result);
+void aio_wait (unsigned min_complete);
+void aio_drain (void);
+struct file_desc *aio_failed_open (void);
+void aio_exit (void);
+void aio_print_stats (void);
+
+#endif /* vm/aio.h */
@@ -1,53 +1,156 @@
 #include "vm/frame.h"
 #include "vm/page.h"
+#include "vm/pagecache.h"
 #include "vm/swap.h"
 #include "filesys/file.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
 #include "threads/palloc.h"
 #include "threads/malloc.h"
+#include "threads/vaddr.h"
 #include "userprog/pagedir.h"
 #include <stdio.h>
+#include <string.h>
+
+#define AGE_REFERENCED 0x80
+//Set in a frame's age when its page was accessed since the last pass
+#define AGING_PERIOD (TIMER_FREQ / 4)
+//Ticks between two passes of the aging thread
+#define AGE_BUCKETS 9
+//One bucket for age 0 and one for each bit that can be the highest set
+
+static struct frame_entry **frame_index;
+/*Frame table entries by physical page number, so a frame found in a page
+table or handed to frame_free() needs no search of the frame table*/
+static int64_t last_aging;
+/*Tick of the last aging pass*/
+static struct condition evict_done;
+/*Signaled under frame_table_lock when an eviction has written its page out*/
+static struct list_elem *scan_cursor;
+/*Next frame for the KSM scanner, moved on when that frame is removed*/
+static struct list age_buckets[AGE_BUCKETS];
+/*Frames by the highest set bit of their age, that is by the last pass
+that found them accessed, bucket 0 for never. Each bucket is in allocation
+order, so the oldest frame is at the front of the first non-empty one*/
+
+/*Processes found by one aging pass*/
+struct frame_procs {
+    struct thread **procs;
+    size_t cnt;
+    size_t max;
+};
+
+static thread_func frame_aging_thread NO_RETURN;
 
 /*Function to initialize the frame table and lock*/
 void frame_table_init (void){
+    size_t i;
     list_init(&frame_table);
+    for (i = 0; i < AGE_BUCKETS; i++)
+        list_init(&age_buckets[i]);
     lock_init(&frame_table_lock);
+    cond_init(&evict_done);
+}
+
+/*Function to allocate the frame index and start the aging thread, called
+once malloc() works and before any user process runs*/
+void frame_aging_init (void){
+    frame_index = calloc(init_ram_pages, sizeof *frame_index);
+    if (frame_index == NULL)
+        PANIC("frame_aging_init: cannot allocate frame index");
+    thread_create("frame_aging", PRI_DEFAULT, frame_aging_thread, NULL);
+}
+
+static size_t frame_no (void *frame){
+    return vtop(frame) >> PGBITS;
+}
+
+/*Function to return the age bucket of FTE*/
+static struct list *frame_bucket (struct frame_entry *fte){
+    size_t b = 0;
+    uint8_t age;
+    for (age = fte->age; age != 0; age >>= 1)
+        b++;
+    return &age_buckets[b];
+}
+
+/*Function to find the entry of FRAME, must hold frame_table_lock. Returns
+NULL for frames outside the frame table*/
+struct frame_entry *frame_lookup (void *frame){
+    return frame_index[frame_no(frame)];
+}
+
+/*Function to take FTE out of the frame table, must hold frame_table_lock*/
+void frame_remove (struct frame_entry *fte){
+    if (scan_cursor == &fte->elem)
+        scan_cursor = list_next(scan_cursor);
+    list_remove(&fte->elem);
+    list_remove(&fte->age_elem);
+    frame_index[frame_no(fte->frame)] = NULL;
+}
+
+/*Function to return where the KSM scanner left off, must hold
+frame_table_lock. The frame table is never reordered, so a pass sees every
+frame that stays in the table once*/
+struct list_elem *frame_scan_cursor (void){
+    return scan_cursor != NULL ? scan_cursor : list_begin(&frame_table);
+}
+
+/*Function to set where the KSM scanner goes on, must hold frame_table_lock*/
+void frame_set_scan_cursor (struct list_elem *e){
+    scan_cursor = e;
+}
+
+/*Function to clear the current process's page directory before it is
+destroyed. Under frame_table_lock, so an aging pass never walks page
+tables that are being freed*/
+void frame_release_pagedir (void){
+    lock_acquire(&frame_table_lock);
+    thread_current()->pagedir = NULL;
+    lock_release(&frame_table_lock);
 }
 
 /*Function to free the specific frame using given address*/
 void frame_free (void *frame){
-    struct list_elem *e;
     lock_acquire(&frame_table_lock);
     //Need lock cause we may have multipule access different processes
-    for (e = list_begin(&frame_table); e != list_end(&frame_table);e = list_next(e)){
-        struct frame_entry *fte = list_entry(e, struct frame_entry, elem);
-        if (fte->frame == frame){
-            //If we can find the frame within the given list
-            list_remove(e);
-            //First we remove it from the list
-            free(fte);
-            //Second we free the entire fte entry
-            break;
-        }
+    struct frame_entry *fte = frame_lookup(frame);
+    if (fte != NULL){
+        frame_remove(fte);
+        //First we remove it from the list
+        free(fte);
+        //Second we free the entire fte entry
     }
     lock_release(&frame_table_lock);
-    palloc_free_page(frame);
-    //Finally we free that frame directly
+    if (fte != NULL) palloc_free_page(frame);
+    //Finally we free that frame directly, unless it was already given back
 }
 
-/*Function to allocate the frame, the allocated frame will be added to the frame table*/
+/*Function to allocate the frame, the allocated frame will be added to the
+frame table. Returns NULL if there is no free frame and none to evict*/
 void* frame_allocate_user(struct sup_page_table_entry *spte) {
-    void *kpage = palloc_get_page(PAL_USER | PAL_ZERO);
-    if(kpage != NULL) {
-        // Successfully acquired a frame from user pool
-        frame_add_to_table(kpage, spte);
-        //Add that page to page table
-        return kpage;
-    }
-    else {
-        kpage = frame_evict();
-        frame_add_to_table(kpage, spte);
-        return kpage;
+    void *kpage;
+    for (;;) {
+        kpage = palloc_get_page(PAL_USER | PAL_ZERO);
+        //Idle page cache pages go before any process loses a frame
+        while(kpage == NULL && pcache_shrink())
+            kpage = palloc_get_page(PAL_USER | PAL_ZERO);
+        if(kpage == NULL)
+            kpage = frame_evict();
+        if(kpage != NULL)
+            break;
+        //Every frame is pinned, give their threads a tick to finish with them
+        lock_acquire(&frame_table_lock);
+        bool empty = list_empty(&frame_table);
+        lock_release(&frame_table_lock);
+        if(empty)
+            return NULL;
+        timer_sleep(1);
     }
+    frame_add_to_table(kpage, spte);
+    //Add that page to page table
+    return kpage;
 }
 
 /*Function adding the allocated frame to the frame table*/
@@ -57,56 +160,186 @@ void frame_add_to_table (void *frame, struct sup_page_table_entry *spte){
     //Set the address
     fte->owner = thread_current();
     fte->spte = spte;
+    fte->age = AGE_REFERENCED;
+    //The page is about to be used, it is not a victim until it ages
 
     lock_acquire(&frame_table_lock);
     list_push_back(&frame_table, &fte->elem);
     //Add this thread to list
+    list_push_back(frame_bucket(fte), &fte->age_elem);
+    frame_index[frame_no(frame)] = fte;
     lock_release(&frame_table_lock);
 }
-/*Function to evict a frame from the list*/
+/*Function called for each accessed page found by the aging pass, AUX is
+the process whose page directory is walked. Frames outside the table keep
+their accessed bits, the page cache reads them for its mapped pages*/
+static bool frame_age_accessed (void *kpage, void *aux){
+    struct frame_entry *fte = frame_lookup(kpage);
+    //Shared frames of the KSM scanner and the page cache are not in the table
+    if (fte == NULL)
+        return false;
+    if (fte->owner == aux)
+        fte->age |= AGE_REFERENCED;
+    return true;
+}
+
+static void frame_count_process (struct thread *t, void *aux){
+    if (t->pagedir != NULL)
+        ++*(size_t *) aux;
+}
+
+static void frame_collect_process (struct thread *t, void *aux){
+    struct frame_procs *fp = aux;
+    if (t->pagedir != NULL && fp->cnt < fp->max)
+        fp->procs[fp->cnt++] = t;
+}
+
+/*Function to age every frame, must hold frame_table_lock. Ages are shifted
+right and the accessed bits of each process are folded in by one walk of
+its page tables. Interrupts are only off to list the processes, holding
+frame_table_lock keeps them from dropping their page tables meanwhile, see
+frame_release_pagedir(). The age buckets are rebuilt from the new ages
+once the pass is over, the table itself keeps its order*/
+static void frame_age (void){
+    struct list_elem *e;
+    struct frame_procs fp;
+    enum intr_level old_level;
+    size_t i;
+
+    for (e = list_begin(&frame_table); e != list_end(&frame_table); e = list_next(e))
+        list_entry(e, struct frame_entry, elem)->age >>= 1;
+    fp.max = 0;
+    old_level = intr_disable();
+    thread_foreach(frame_count_process, &fp.max);
+    intr_set_level(old_level);
+    //Processes started meanwhile are seen by the next pass
+    fp.procs = fp.max > 0 ? malloc(fp.max * sizeof *fp.procs) : NULL;
+    fp.cnt = 0;
+    if (fp.procs != NULL){
+        old_level = intr_disable();
+        thread_foreach(frame_collect_process, &fp);
+        intr_set_level(old_level);
+        for (i = 0; i < fp.cnt; i++)
+            pagedir_harvest_accessed(fp.procs[i]->pagedir, frame_age_accessed, fp.procs[i]);
+        free(fp.procs);
+    }
+    for (i = 0; i < AGE_BUCKETS; i++)
+        list_init(&age_buckets[i]);
+    for (e = list_begin(&frame_table); e != list_end(&frame_table); e = list_next(e)){
+        struct frame_entry *fte = list_entry(e, struct frame_entry, elem);
+        list_push_back(frame_bucket(fte), &fte->age_elem);
+    }
+    last_aging = timer_ticks();
+}
+
+/*The aging thread, keeps the ages of the frames current in the background*/
+static void frame_aging_thread (void *aux UNUSED){
+    for (;;){
+        timer_sleep(AGING_PERIOD);
+        lock_acquire(&frame_table_lock);
+        frame_age();
+        lock_release(&frame_table_lock);
+    }
+}
+
+/*Function to wait until an eviction that has picked SPTE's page has
+written it out, called by the page fault handler*/
+void frame_wait_evicted (struct sup_page_table_entry *spte){
+    lock_acquire(&frame_table_lock);
+    while(spte->evicting)
+        cond_wait(&evict_done, &frame_table_lock);
+    lock_release(&frame_table_lock);
+}
+
+/*Function to claim SPTE's page for an eviction that is not in the frame
+table, by the page cache taking a page from its mappers. Returns false if
+the page is pinned. The owner's faults and frame_pin() wait until
+frame_end_evict() is called*/
+bool frame_begin_evict (struct sup_page_table_entry *spte){
+    bool claimed;
+    lock_acquire(&frame_table_lock);
+    claimed = !spte->no_eviction && !spte->evicting;
+    if (claimed)
+        spte->evicting = true;
+    lock_release(&frame_table_lock);
+    return claimed;
+}
+
+/*Function to end an eviction started by frame_begin_evict()*/
+void frame_end_evict (struct sup_page_table_entry *spte){
+    lock_acquire(&frame_table_lock);
+    spte->evicting = false;
+    cond_broadcast(&evict_done, &frame_table_lock);
+    lock_release(&frame_table_lock);
+}
+
+/*Function to keep SPTE's page from being evicted, before the current
+process releases it. Waits for an eviction that has already picked it*/
+void frame_pin (struct sup_page_table_entry *spte){
+    lock_acquire(&frame_table_lock);
+    spte->no_eviction = true;
+    while(spte->evicting)
+        cond_wait(&evict_done, &frame_table_lock);
+    lock_release(&frame_table_lock);
+}
+
+/*Function to evict a frame from the list and return it zeroed, or NULL if
+every frame is pinned. The victim is the front of the first non-empty age
+bucket, pinned frames are skipped. It is taken out of the table and marked
+evicting under frame_table_lock, the lock is dropped before the page is
+written out, so the write may block on file locks held by a thread that
+faults and waits here meanwhile*/
 void* frame_evict (void){
     struct list_elem *e;
+    struct frame_entry *fra = NULL;
+    size_t i;
     lock_acquire(&frame_table_lock);
     //Need lock cause we may have multipule access different processes
-    while (1) {
-        //if all frames are used, choose the first one
-        for (e = list_begin(&frame_table); e != list_end(&frame_table);e = list_next(e))
+    //Catch up if the aging thread has not run lately
+    if (timer_elapsed(last_aging) >= AGING_PERIOD)
+        frame_age();
+    for (i = 0; i < AGE_BUCKETS && fra == NULL; i++)
+        for (e = list_begin(&age_buckets[i]); e != list_end(&age_buckets[i]); e = list_next(e))
         {
-            struct frame_entry *fra = list_entry(e, struct frame_entry, elem); //check each frame structure
-            if(!(fra->spte)->no_eviction)
-            {
-              struct thread* thre = fra->owner;
-              //if the page is recently accessed, reset it as not accessed
-              if(pagedir_is_accessed(thre->pagedir, fra->spte->uva))
-                pagedir_set_accessed(thre->pagedir, fra->spte->uva, false);
-              //the frame, least recently used
-              else
-              {
-                if(pagedir_is_dirty(thre->pagedir, fra->spte->uva) || fra->spte->type == SWAP)
-                {
-                  if(fra->spte->type == MMAP)
-                  {
-                    //lock_acquire(&filesys_lock);
-                    //write from frame to buffer
-                    file_write_at(fra->spte->file, fra->frame, fra->spte->read_bytes, fra->spte->offset);
-                    //lock_release(&filesys_lock);
-                  }
-                  else{
-                    fra->spte->type = SWAP;
-                    //record the swapped frame
-                    fra->spte->swap_index = swap_out(fra->frame);
-                  }
-                }
-                fra->spte->is_loaded = false; //change the is_loaded
-                list_remove(&fra->elem); //remove the frame from frame table
-                lock_release(&frame_table_lock);
-                pagedir_clear_page(thre->pagedir, fra->spte->uva); //clean the corresponding page
-                palloc_free_page(fra->frame);
-                free(fra); //free the frame
-                return palloc_get_page(PAL_USER); //the next free page, as one is evicted
-              }
+            struct frame_entry *f = list_entry(e, struct frame_entry, age_elem);
+            if(!f->spte->no_eviction) {
+                fra = f;
+                break;
             }
         }
+    if (fra == NULL) {
+        lock_release(&frame_table_lock);
+        return NULL;
+    }
+    struct sup_page_table_entry *spte = fra->spte;
+    struct thread* thre = fra->owner;
+    spte->evicting = true;
+    frame_remove(fra); //remove the frame from frame table
+    lock_release(&frame_table_lock);
+
+    //No more writes through the mapping, the dirty bit stays readable
+    pagedir_clear_page(thre->pagedir, spte->uva);
+    if(pagedir_is_dirty(thre->pagedir, spte->uva) || spte->type == SWAP)
+    {
+      if(spte->type == MMAP)
+      {
+        //write from frame to file, through the page cache so its copy is current
+        pcache_write_at(spte->file, fra->frame, spte->read_bytes, spte->offset);
+      }
+      else{
+        spte->type = SWAP;
+        //record the swapped frame
+        spte->swap_index = swap_out(fra->frame);
+      }
     }
 
+    lock_acquire(&frame_table_lock);
+    spte->is_loaded = false; //change the is_loaded
+    spte->evicting = false;
+    cond_broadcast(&evict_done, &frame_table_lock);
+    lock_release(&frame_table_lock);
+    void *frame = fra->frame;
+    free(fra); //free the frame entry
+    memset(frame, 0, PGSIZE);
+    return frame; //the evicted frame is reused directly
 }
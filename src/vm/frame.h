@@ -17,14 +17,28 @@ struct frame_entry {
    	// The owner of the frame
    	struct sup_page_table_entry *spte;
    	// Pointer to the page table entry currently using this physical frame
+   	uint8_t age;
+   	// Accessed bits of the last aging passes, newest in the top bit
    	struct list_elem elem;
+   	struct list_elem age_elem;
+   	// In the age bucket of the last pass that found the page accessed
 };
 
 /* Allocates a new physical frame for current user process. */
 void* frame_allocate_user(struct sup_page_table_entry *spte);
 void frame_table_init (void);
+void frame_aging_init (void);
+struct frame_entry *frame_lookup (void *frame);
+void frame_remove (struct frame_entry *fte);
+struct list_elem *frame_scan_cursor (void);
+void frame_set_scan_cursor (struct list_elem *e);
+void frame_release_pagedir (void);
 void frame_free (void *frame);
 void frame_add_to_table (void *frame, struct sup_page_table_entry *spte);
 void* frame_evict (void);
+void frame_wait_evicted (struct sup_page_table_entry *spte);
+bool frame_begin_evict (struct sup_page_table_entry *spte);
+void frame_end_evict (struct sup_page_table_entry *spte);
+void frame_pin (struct sup_page_table_entry *spte);
 
 #endif /* vm/frame.h */
@@ -0,0 +1,282 @@
+#include "vm/ksm.h"
+#include "vm/frame.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include <stdio.h>
+#include <string.h>
+
+#define KSM_WAKEUPS_PER_SEC 10
+//The scanner spends its budget in this many slices per second
+
+/*A frame seen once with a stable checksum, waiting for a twin*/
+struct ksm_candidate {
+	unsigned checksum;
+	void *frame;
+	struct hash_elem elem;
+};
+
+int ksm_pages_per_sec;
+
+static struct hash stable;
+/*Shared frames, by checksum*/
+static struct hash unstable;
+/*Candidates of the current pass over the frame table, by checksum*/
+static struct lock ksm_lock;
+/*Protects both tables and the ref_cnt of every shared frame*/
+
+static int shared_cnt;
+static int sharing_cnt;
+
+static thread_func ksm_thread NO_RETURN;
+
+static unsigned ksm_hash_func (const struct hash_elem *e, void *aux UNUSED){
+	return hash_entry(e, struct ksm_page, elem)->checksum;
+}
+
+static bool ksm_less_func (const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED){
+	return hash_entry(a, struct ksm_page, elem)->checksum
+	     < hash_entry(b, struct ksm_page, elem)->checksum;
+}
+
+static unsigned candidate_hash_func (const struct hash_elem *e, void *aux UNUSED){
+	return hash_entry(e, struct ksm_candidate, elem)->checksum;
+}
+
+static bool candidate_less_func (const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED){
+	return hash_entry(a, struct ksm_candidate, elem)->checksum
+	     < hash_entry(b, struct ksm_candidate, elem)->checksum;
+}
+
+static void candidate_free (struct hash_elem *e, void *aux UNUSED){
+	free(hash_entry(e, struct ksm_candidate, elem));
+}
+
+/*Function to initialize the tables and start the scanner if enabled*/
+void ksm_init (void){
+	hash_init(&stable, ksm_hash_func, ksm_less_func, NULL);
+	hash_init(&unstable, candidate_hash_func, candidate_less_func, NULL);
+	lock_init(&ksm_lock);
+	if (ksm_pages_per_sec > 0)
+		thread_create("ksm", PRI_MIN, ksm_thread, NULL);
+}
+
+/*Function to check whether a frame can be merged: a loaded anonymous page
+that nobody is releasing and that is still mapped to this very frame*/
+static bool ksm_candidate (struct frame_entry *fte){
+	struct sup_page_table_entry *spte = fte->spte;
+	struct thread *t = fte->owner;
+	return spte != NULL && spte->is_loaded && !spte->no_eviction
+	    && spte->ksm == NULL && (spte->type == SWAP || spte->type == ZERO)
+	    && t->pagedir != NULL
+	    && pagedir_get_page(t->pagedir, spte->uva) == fte->frame;
+}
+
+/*Function to remove FTE from the frame table without breaking the scan
+iterator NEXT, must hold frame_table_lock*/
+static void frame_unlink (struct frame_entry *fte, struct list_elem **next){
+	if (*next == &fte->elem)
+		*next = list_next(*next);
+	frame_remove(fte);
+}
+
+/*Function to point FTE's page at the shared frame KP, read-only. Interrupts
+are off from the last check to the switch, so the owner can neither write
+the page nor start releasing it in between*/
+static bool ksm_map (struct frame_entry *fte, struct ksm_page *kp){
+	struct sup_page_table_entry *spte = fte->spte;
+	uint32_t *pd = fte->owner->pagedir;
+	bool success = false;
+	enum intr_level old_level = intr_disable();
+	if (ksm_candidate(fte) && (fte->frame == kp->kpage
+	                           || !memcmp(fte->frame, kp->kpage, PGSIZE))){
+		pagedir_clear_page(pd, spte->uva);
+		pagedir_set_page(pd, spte->uva, kp->kpage, false);
+		spte->ksm = kp;
+		kp->ref_cnt++;
+		sharing_cnt++;
+		success = true;
+	}
+	intr_set_level(old_level);
+	return success;
+}
+
+/*Function to turn FTE's frame into a new shared frame, must hold both locks*/
+static struct ksm_page *ksm_share (struct frame_entry *fte, struct list_elem **next){
+	struct ksm_page *kp = malloc(sizeof(struct ksm_page));
+	if (kp == NULL)
+		return NULL;
+	kp->kpage = fte->frame;
+	kp->checksum = fte->spte->ksm_checksum;
+	kp->ref_cnt = 0;
+	if (!ksm_map(fte, kp)){
+		free(kp);
+		return NULL;
+	}
+	hash_insert(&stable, &kp->elem);
+	shared_cnt++;
+	//The frame now belongs to the shared page, not to the frame table
+	frame_unlink(fte, next);
+	free(fte);
+	return kp;
+}
+
+/*Function to map FTE's page to KP and give its own frame back, must hold both locks*/
+static bool ksm_merge (struct frame_entry *fte, struct ksm_page *kp, struct list_elem **next){
+	if (!ksm_map(fte, kp))
+		return false;
+	frame_unlink(fte, next);
+	palloc_free_page(fte->frame);
+	free(fte);
+	return true;
+}
+
+/*Function to look at one frame, must hold frame_table_lock. Frames are only
+merged once their checksum is the same on two passes in a row, so pages
+that are being written are left alone*/
+static void ksm_scan_frame (struct frame_entry *fte, struct list_elem **next){
+	if (!ksm_candidate(fte))
+		return;
+	unsigned checksum = hash_bytes(fte->frame, PGSIZE);
+	if (checksum != fte->spte->ksm_checksum){
+		fte->spte->ksm_checksum = checksum;
+		return;
+	}
+
+	lock_acquire(&ksm_lock);
+	struct ksm_page key;
+	key.checksum = checksum;
+	struct hash_elem *e = hash_find(&stable, &key.elem);
+	if (e != NULL){
+		ksm_merge(fte, hash_entry(e, struct ksm_page, elem), next);
+		lock_release(&ksm_lock);
+		return;
+	}
+
+	struct ksm_candidate ckey;
+	ckey.checksum = checksum;
+	e = hash_find(&unstable, &ckey.elem);
+	if (e == NULL){
+		struct ksm_candidate *c = malloc(sizeof(struct ksm_candidate));
+		if (c != NULL){
+			c->checksum = checksum;
+			c->frame = fte->frame;
+			hash_insert(&unstable, &c->elem);
+		}
+		lock_release(&ksm_lock);
+		return;
+	}
+
+	//The frame may have been freed or reused since it became a candidate
+	struct ksm_candidate *c = hash_entry(e, struct ksm_candidate, elem);
+	struct frame_entry *other = frame_lookup(c->frame);
+	if (other == NULL || other == fte || !ksm_candidate(other)
+	    || memcmp(other->frame, fte->frame, PGSIZE)){
+		c->frame = fte->frame;
+		lock_release(&ksm_lock);
+		return;
+	}
+	hash_delete(&unstable, &c->elem);
+	free(c);
+	struct ksm_page *kp = ksm_share(other, next);
+	if (kp != NULL)
+		ksm_merge(fte, kp, next);
+	lock_release(&ksm_lock);
+}
+
+/*Function to scan the next BUDGET frames of the frame table*/
+static void ksm_scan (size_t budget){
+	struct list_elem *e;
+
+	lock_acquire(&frame_table_lock);
+	e = frame_scan_cursor();
+	while (budget-- > 0){
+		if (e == list_end(&frame_table)){
+			//One pass is over, candidates are only matched within a pass
+			lock_acquire(&ksm_lock);
+			hash_clear(&unstable, candidate_free);
+			lock_release(&ksm_lock);
+			e = list_begin(&frame_table);
+			if (e == list_end(&frame_table))
+				break;
+		}
+		struct frame_entry *fte = list_entry(e, struct frame_entry, elem);
+		e = list_next(e);
+		ksm_scan_frame(fte, &e);
+	}
+	frame_set_scan_cursor(e);
+	lock_release(&frame_table_lock);
+}
+
+/*The scanner thread, sleeps between slices so it stays within its budget*/
+static void ksm_thread (void *aux UNUSED){
+	size_t budget = ksm_pages_per_sec / KSM_WAKEUPS_PER_SEC;
+	if (budget == 0)
+		budget = 1;
+	for (;;){
+		timer_sleep(TIMER_FREQ / KSM_WAKEUPS_PER_SEC);
+		ksm_scan(budget);
+	}
+}
+
+/*Function to drop one reference to KP, freeing the frame with the last one*/
+static void ksm_put (struct ksm_page *kp){
+	lock_acquire(&ksm_lock);
+	sharing_cnt--;
+	if (--kp->ref_cnt == 0){
+		hash_delete(&stable, &kp->elem);
+		shared_cnt--;
+		palloc_free_page(kp->kpage);
+		free(kp);
+	}
+	lock_release(&ksm_lock);
+}
+
+/*Function to give the current process a private copy of a shared page,
+called on a write fault. Returns false if no frame could be allocated*/
+bool ksm_break_cow (struct sup_page_table_entry *spte){
+	struct thread *t = thread_current();
+	struct ksm_page *kp = spte->ksm;
+	spte->no_eviction = true;
+	void *kpage = frame_allocate_user(spte);
+	if (kpage == NULL){
+		spte->no_eviction = false;
+		return false;
+	}
+	//Our reference keeps the shared frame alive while we copy
+	memcpy(kpage, kp->kpage, PGSIZE);
+	enum intr_level old_level = intr_disable();
+	pagedir_clear_page(t->pagedir, spte->uva);
+	pagedir_set_page(t->pagedir, spte->uva, kpage, spte->writable);
+	//The copy exists nowhere else, eviction has to write it to swap
+	pagedir_set_dirty(t->pagedir, spte->uva, true);
+	spte->ksm = NULL;
+	intr_set_level(old_level);
+	spte->no_eviction = false;
+	ksm_put(kp);
+	return true;
+}
+
+/*Function to unmap a shared page of the current process and drop its
+reference, the caller must have set no_eviction first*/
+void ksm_drop (struct sup_page_table_entry *spte){
+	struct thread *t = thread_current();
+	struct ksm_page *kp = spte->ksm;
+	enum intr_level old_level = intr_disable();
+	if (t->pagedir != NULL)
+		pagedir_clear_page(t->pagedir, spte->uva);
+	spte->ksm = NULL;
+	intr_set_level(old_level);
+	ksm_put(kp);
+}
+
+/*Prints same-page merging statistics*/
+void ksm_print_stats (void){
+	printf("KSM: %d shared frames mapped by %d pages, %d pages saved\n",
+	       shared_cnt, sharing_cnt, sharing_cnt - shared_cnt);
+}
@@ -0,0 +1,30 @@
+#ifndef VM_KSM_H
+#define VM_KSM_H
+
+#include <stdbool.h>
+#include <hash.h>
+#include "vm/page.h"
+
+/*Same-page merging: a low priority kernel thread hashes resident anonymous
+frames and maps identical ones to a single read-only frame, which is copied
+again on the first write*/
+
+struct ksm_page {
+	void *kpage;
+	// The shared physical frame, not part of the frame table
+	unsigned checksum;
+	// hash_bytes() of the frame content
+	int ref_cnt;
+	// Number of sptes mapping the frame
+	struct hash_elem elem;
+};
+
+extern int ksm_pages_per_sec;
+/*Scan budget set by the -ksm kernel option, 0 leaves the scanner off*/
+
+void ksm_init (void);
+bool ksm_break_cow (struct sup_page_table_entry *spte);
+void ksm_drop (struct sup_page_table_entry *spte);
+void ksm_print_stats (void);
+
+#endif /* vm/ksm.h */
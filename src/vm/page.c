@@ -1,5 +1,6 @@
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "userprog/process.h"
@@ -7,7 +8,10 @@
 #include "userprog/syscall.h"
 #include "filesys/file.h"
 #include "vm/frame.h"
+#include "vm/ksm.h"
 #include "vm/page.h"
+#include "vm/pagecache.h"
+#include "vm/prefetch.h"
 #include "vm/swap.h"
 #include <string.h>
 #include <stdio.h>
@@ -29,9 +33,11 @@ bool page_hash_less_func (const struct hash_elem *elem1,const struct hash_elem *
    	return false;
  }
 
-/*Functions to perform free() action on hash elements.*/
+/*Functions to perform free() action on hash elements, the page's frame or
+swap slot is given back first so no frame table entry outlives the process.*/
 void page_hash_action_func (struct hash_elem *e, void *aux UNUSED){
    struct sup_page_table_entry *spte = hash_entry(e, struct sup_page_table_entry, elem);
+   page_drop(spte);
    free(spte);
 }
 
@@ -59,23 +65,27 @@ struct sup_page_table_entry * get_spte (const void *uva){
 
 bool page_load_swap (struct sup_page_table_entry * spte){
 	uint8_t *frame = frame_allocate_user(spte);
+	if(frame == NULL) return false;
     install_page(spte->uva, frame, spte->writable);
     swap_in(spte->swap_index, spte->uva);
     spte->is_loaded = true;
     return true;
 }
 
+/*Function to map the page cache's copy of a mapped file page, so every
+process mapping the file and every read() share it. Falls back to a private
+copy when the page cannot be cached*/
 bool page_load_mmap (struct sup_page_table_entry * spte){
-   	return page_load_file(spte);
+	if(pcache_map(file_get_inode(spte->file), spte->offset, spte)) return true;
+	return page_load_file(spte);
 }
 
-/*Function to load page from a file*/
+/*Function to load page from a file, copied from the page cache*/
 bool page_load_file (struct sup_page_table_entry * spte){
 	// printf("inside page_load_file, loading for %p\n",spte->uva);
-	file_seek(spte->file, spte->offset);
 	void *kpage = frame_allocate_user(spte);
 	if(kpage == NULL) return false;  // Unknown error happened
-	if(file_read (spte->file, kpage, spte->read_bytes) != (int) spte->read_bytes) {
+	if(pcache_read_at(file_get_inode(spte->file), kpage, spte->read_bytes, spte->offset) != (int) spte->read_bytes) {
 		frame_free(kpage);
 		return false;
 	}
@@ -85,6 +95,18 @@ bool page_load_file (struct sup_page_table_entry * spte){
     return true;
 }
 
+/*Function to load a demand-zero page, the new frame is already zeroed*/
+bool page_load_zero (struct sup_page_table_entry * spte){
+	void *kpage = frame_allocate_user(spte);
+	if(kpage == NULL) return false;
+	if(!install_page(spte->uva, kpage, spte->writable)) {
+		frame_free(kpage);
+		return false;
+	}
+	spte->is_loaded = true;
+	return true;
+}
+
 /*Function to load in page using specific functions*/
 bool page_load (const void *uva){
     struct sup_page_table_entry * spte = get_spte(uva);
@@ -96,6 +118,7 @@ bool page_load (const void *uva){
     switch (spte->type){
       case FILE:
         success = page_load_file(spte);
+        if(success) prefetch_record(uva);
         break;
       case SWAP:
         success = page_load_swap(spte);
@@ -103,6 +126,9 @@ bool page_load (const void *uva){
       case MMAP:
         success = page_load_mmap(spte);
         break;
+      case ZERO:
+        success = page_load_zero(spte);
+        break;
         default:
         printf("Unknown page type\n");
     }
@@ -131,6 +157,11 @@ bool page_grow_stack (const void *uva){
   spte->is_loaded = true;
   spte->type = SWAP;
   spte->writable= true;
+  spte->no_eviction = false;
+  spte->evicting = false;
+  spte->ksm = NULL;
+  spte->ksm_checksum = 0;
+  spte->pcache = NULL;
 
   if( !page_allocate_user(uva, true, spte) ) {
       // Failed to allocate a new user page, swapping is needed.
@@ -169,6 +200,11 @@ bool page_grow_file(const void* uva, struct file *file, off_t ofs, size_t page_r
 	spte->file = file;
 	spte->read_bytes = page_read_bytes;
 	spte->zero_bytes = page_zero_bytes;
+	spte->no_eviction = false;
+	spte->evicting = false;
+	spte->ksm = NULL;
+	spte->ksm_checksum = 0;
+	spte->pcache = NULL;
 	hash_insert(&thread_current()->sup_page_table, &spte->elem);
 	return true;
 }
@@ -188,6 +224,11 @@ bool page_grow_mmap(const void* uva, struct file *file, off_t ofs, size_t page_r
 	spte->file = file;
 	spte->read_bytes = page_read_bytes;
 	spte->zero_bytes = page_zero_bytes;
+	spte->no_eviction = false;
+	spte->evicting = false;
+	spte->ksm = NULL;
+	spte->ksm_checksum = 0;
+	spte->pcache = NULL;
 	hash_insert(&thread_current()->sup_page_table, &spte->elem);
 	return true;
 }
@@ -197,24 +238,108 @@ struct sup_page_table_entry* mmap_release_page(void* uva, struct file* f, int of
 	bool success = true;
 	struct sup_page_table_entry *spte = get_spte(uva);
 	if(spte == NULL) return NULL;
+	// keep eviction and the page cache from taking the page meanwhile
+	frame_pin(spte);
+	if(pcache_unmap(spte, &success)) {
+		// shared with the other mappers, written back once the last one goes
+		return success ? spte : NULL;
+	}
 	if(spte->is_loaded) {
+		void* kpage = pagedir_get_page(t->pagedir, uva);
 		if(pagedir_is_dirty(t->pagedir, uva)) {
-			// write back
-			lock_acquire(&file_lock);
-			file_seek(f, ofs);
-			if(file_write(f, uva, write_bytes) != write_bytes) success = false;
-			lock_release(&file_lock);
+			// write back through the page cache, so its copy of the page is current
+			if(pcache_write_at(f, kpage, write_bytes, ofs) != write_bytes) success = false;
 		}
 		if(!success) return NULL;
-		void* kpage = pagedir_get_page(thread_current()->pagedir, uva);
-		pagedir_clear_page(thread_current()->pagedir, uva);
+		pagedir_clear_page(t->pagedir, uva);
 		frame_free(kpage);
 	}
 	return spte;
 }
 
+// allocate a new spte entry for a demand-zero page, no frame is used until the first fault
+bool page_grow_zero(const void* uva, bool writable) {
+	struct sup_page_table_entry *spte = malloc(
+	  sizeof(struct sup_page_table_entry));
+	if (spte==NULL)
+	  return false;
+	//Failed to allowcate the sup page entry
+	spte->uva = pg_round_down(uva);
+	spte->is_loaded = false;
+	spte->type = ZERO;
+	spte->writable = writable;
+	spte->file = NULL;
+	spte->offset = 0;
+	spte->read_bytes = 0;
+	spte->zero_bytes = PGSIZE;
+	spte->no_eviction = false;
+	spte->evicting = false;
+	spte->ksm = NULL;
+	spte->ksm_checksum = 0;
+	spte->pcache = NULL;
+	hash_insert(&thread_current()->sup_page_table, &spte->elem);
+	return true;
+}
+
+// map kernel page KPAGE at uva for good, it is not in the frame table so
+// eviction never sees it and no_eviction keeps the merging scan away
+bool page_grow_aio(const void* uva, void* kpage) {
+	struct sup_page_table_entry *spte = malloc(
+	  sizeof(struct sup_page_table_entry));
+	if (spte==NULL)
+	  return false;
+	spte->uva = pg_round_down(uva);
+	spte->is_loaded = true;
+	spte->type = AIO;
+	spte->writable = true;
+	spte->file = NULL;
+	spte->offset = 0;
+	spte->read_bytes = 0;
+	spte->zero_bytes = 0;
+	spte->no_eviction = true;
+	spte->evicting = false;
+	spte->ksm = NULL;
+	spte->ksm_checksum = 0;
+	spte->pcache = NULL;
+	if(!pagedir_set_page(thread_current()->pagedir, spte->uva, kpage, true)) {
+		free(spte);
+		return false;
+	}
+	hash_insert(&thread_current()->sup_page_table, &spte->elem);
+	return true;
+}
+
 bool page_delete_spte(struct sup_page_table_entry* spte) {
 	hash_delete(&thread_current()->sup_page_table, &spte->elem);
 	free(spte);
 	return true;
 }
+
+// free the frame or the swap slot behind a page of the current process
+// without writing it anywhere
+void page_drop(struct sup_page_table_entry* spte) {
+	struct thread* t = thread_current();
+	// keep the eviction and merging scans away before looking at the page
+	frame_pin(spte);
+	if(spte->ksm != NULL) {
+		ksm_drop(spte);
+	}
+	else if(spte->type == MMAP && pcache_unmap(spte, NULL)) {
+		// the mapping is gone, the page stays in the page cache
+	}
+	else if(spte->is_loaded) {
+		if(t->pagedir == NULL) return;
+		void* kpage = pagedir_get_page(t->pagedir, spte->uva);
+		pagedir_clear_page(t->pagedir, spte->uva);
+		if(kpage != NULL) frame_free(kpage);
+	}
+	else if(spte->type == SWAP) {
+		swap_free(spte->swap_index);
+	}
+}
+
+// drop an anonymous page, then remove the spte from the supplementary page table
+void page_release(struct sup_page_table_entry* spte) {
+	page_drop(spte);
+	page_delete_spte(spte);
+}
@@ -6,10 +6,19 @@
 #include "filesys/off_t.h"
 #include <hash.h>
 
+struct ksm_page;
+struct pcache_page;
+
 /*Defind the different types of each page*/
 #define FILE 0
 #define SWAP 1
 #define MMAP 2
+#define ZERO 3
+/*ZERO pages have no backing data, they read back as zeros until first
+written and move to swap once they are evicted dirty*/
+#define AIO 4
+/*AIO pages are kernel pages shared with the asynchronous I/O workers, they
+stay mapped and pinned until the process exits, see vm/aio.h*/
 
 struct sup_page_table_entry {
 	uint8_t type;
@@ -40,6 +49,15 @@ struct sup_page_table_entry {
     // The hash element to add to the supplemental
 	bool no_eviction;
 	//avoid race condition in eviction and page fault and syscall
+	bool evicting;
+	// Set while frame_evict() writes the page out, see frame_pin()
+	struct ksm_page *ksm;
+	// Shared frame the page is mapped to read-only, NULL if not merged
+	unsigned ksm_checksum;
+	// Content hash seen by the last merging scan, see vm/ksm.h
+	struct pcache_page *pcache;
+	// Page cache page a mapped file page is mapped to, NULL for private frames,
+	// set and cleared under the page cache's lock with the page's reverse map
  };
 
 /* Allocates a new virtual page for current user process and install the page
@@ -57,11 +75,16 @@ bool page_load (const void *uva);
 bool page_load_swap (struct sup_page_table_entry * spte);
 bool page_load_mmap (struct sup_page_table_entry * spte);
 bool page_load_file (struct sup_page_table_entry * spte);
+bool page_load_zero (struct sup_page_table_entry * spte);
 void page_grow_to_esp(void* esp);
 bool page_grow_file(const void* uva, struct file *file, off_t ofs, size_t page_read_bytes, size_t page_zero_bytes, bool writable);
 bool page_grow_mmap(const void* uva, struct file *file, off_t ofs, size_t page_read_bytes, size_t page_zero_bytes);
 bool mmap_write_back(void* uva, struct file* f, int ofs, int write_bytes);
 struct sup_page_table_entry* mmap_release_page(void* uva, struct file* f, int ofs, int write_bytes);
+bool page_grow_zero(const void* uva, bool writable);
+bool page_grow_aio(const void* uva, void* kpage);
 bool page_delete_spte(struct sup_page_table_entry* spte);
+void page_drop(struct sup_page_table_entry* spte);
+void page_release(struct sup_page_table_entry* spte);
 
 #endif /* vm/page.h */
@@ -0,0 +1,696 @@
+#include "vm/pagecache.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+
+/*A cached page of file data. The key, ref_cnt and the LRU position are
+protected by pcache_lock. VALID only goes from false to true while the page
+is in the table, LOCK is held by the thread reading the page in and by
+writers that update it, so the copy and the file change together. The
+reverse map and DIRTY are protected by pcache_lock as well*/
+struct pcache_page {
+	struct inode *inode;
+	// File the page belongs to, the page keeps it open
+	size_t index;
+	// Page number within the file
+	void *kpage;
+	// The data, bytes past the end of file read as zeros
+	int ref_cnt;
+	// Threads copying from or to the page plus user mappings of it
+	struct lock lock;
+	bool valid;
+	// False until the page has been read in
+	struct list mappers;
+	// Reverse map, a pcache_mapping for every user page mapping this one
+	bool dirty;
+	// Written through a mapping that is gone since the last write back
+	bool referenced;
+	// Used since the last look for a mapped page to take, see pcache_reclaim()
+	struct hash_elem elem;
+	struct list_elem lru_elem;
+	// In idle while ref_cnt is 0
+	struct list_elem map_elem;
+	// In mapped while the page has mappers
+};
+
+/*An entry of a page's reverse map. Every mapping also holds a reference
+to the page*/
+struct pcache_mapping {
+	struct thread *owner;
+	// Process whose page table maps the page
+	struct sup_page_table_entry *spte;
+	// Its page, spte->pcache points back to the cached page
+	struct list_elem elem;
+};
+
+static struct hash pages;
+/*Cached pages by (inode, index)*/
+static struct list idle;
+/*Cached pages nobody uses, least recently used first*/
+static struct list mapped;
+/*Cached pages with mappers, the next one to look at for reclaiming first*/
+static struct lock pcache_lock;
+static int page_cnt;
+/*Pages in the table, at most PCACHE_SIZE*/
+
+static long long hit_cnt, miss_cnt, map_cnt, writeback_cnt, reclaim_cnt;
+
+static void pcache_put (struct pcache_page *p);
+
+static unsigned pcache_hash_func (const struct hash_elem *e, void *aux UNUSED){
+	struct pcache_page *p = hash_entry(e, struct pcache_page, elem);
+	return hash_int((int) p->inode) ^ hash_int(p->index);
+}
+
+static bool pcache_less_func (const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED){
+	struct pcache_page *a = hash_entry(a_, struct pcache_page, elem);
+	struct pcache_page *b = hash_entry(b_, struct pcache_page, elem);
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	return a->index < b->index;
+}
+
+/*Function to initialize the page table of the cache and its lock*/
+void pcache_init (void){
+	hash_init(&pages, pcache_hash_func, pcache_less_func, NULL);
+	list_init(&idle);
+	list_init(&mapped);
+	lock_init(&pcache_lock);
+}
+
+/*Function to find page INDEX of INODE and take a reference to it, must
+hold pcache_lock. Returns NULL if the page is not cached*/
+static struct pcache_page *pcache_find (struct inode *inode, size_t index){
+	struct pcache_page key;
+	key.inode = inode;
+	key.index = index;
+	struct hash_elem *e = hash_find(&pages, &key.elem);
+	if (e == NULL)
+		return NULL;
+	struct pcache_page *p = hash_entry(e, struct pcache_page, elem);
+	if (p->ref_cnt++ == 0)
+		list_remove(&p->lru_elem);
+	p->referenced = true;
+	return p;
+}
+
+/*Function to take the least recently used idle page out of the table,
+must hold pcache_lock. Pages whose write back failed stay for a retry by
+pcache_sync(). Its inode is left for the caller to close outside the
+lock*/
+static struct pcache_page *pcache_take_idle (void){
+	struct list_elem *e;
+	for (e = list_begin(&idle); e != list_end(&idle); e = list_next(e)){
+		struct pcache_page *p = list_entry(e, struct pcache_page, lru_elem);
+		if (p->dirty)
+			continue;
+		list_remove(&p->lru_elem);
+		hash_delete(&pages, &p->elem);
+		page_cnt--;
+		return p;
+	}
+	return NULL;
+}
+
+/*Function to write the bytes of P that lie inside its file back to it*/
+static bool pcache_write_page (struct pcache_page *p){
+	off_t ofs = (off_t) p->index * PGSIZE;
+	off_t length = inode_length(p->inode);
+	if (ofs >= length)
+		return true;
+	off_t size = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+	writeback_cnt++;
+	return inode_write_at(p->inode, p->kpage, size, ofs) == size;
+}
+
+/*Function to remove mapping M of P from its process and from the reverse
+map, must hold pcache_lock. The owner is releasing the page itself or the
+page is claimed with frame_begin_evict(), so its fault path does not look
+at the page meanwhile. Whether the process wrote to the page is kept in
+P's dirty flag, the reference of the mapping is left to the caller*/
+static void pcache_detach (struct pcache_page *p, struct pcache_mapping *m){
+	struct sup_page_table_entry *spte = m->spte;
+	uint32_t *pd = m->owner->pagedir;
+	if (pd != NULL){
+		pagedir_clear_page(pd, spte->uva);
+		if (pagedir_is_dirty(pd, spte->uva))
+			p->dirty = true;
+	}
+	spte->is_loaded = false;
+	spte->pcache = NULL;
+	list_remove(&m->elem);
+	free(m);
+	if (list_empty(&p->mappers))
+		list_remove(&p->map_elem);
+}
+
+/*Function to check whether mapped page P may be taken from its mappers,
+must hold pcache_lock. Nobody may be copying from or to it. A page used
+since the last look, through the cache or through a mapping, is given a
+second chance and its reference marks are cleared*/
+static bool pcache_reclaimable (struct pcache_page *p){
+	struct list_elem *e;
+	bool referenced = p->referenced;
+	if ((size_t) p->ref_cnt != list_size(&p->mappers))
+		return false;
+	p->referenced = false;
+	for (e = list_begin(&p->mappers); e != list_end(&p->mappers); e = list_next(e)){
+		struct pcache_mapping *m = list_entry(e, struct pcache_mapping, elem);
+		uint32_t *pd = m->owner->pagedir;
+		if (pd == NULL)
+			return false;
+		if (pagedir_is_accessed(pd, m->spte->uva)){
+			pagedir_set_accessed(pd, m->spte->uva, false);
+			referenced = true;
+		}
+	}
+	return !referenced;
+}
+
+/*Function to claim the pages of every mapper of P for an eviction, must
+hold pcache_lock. Returns false, with nothing claimed, if one is pinned*/
+static bool pcache_claim (struct pcache_page *p){
+	struct list_elem *e, *f;
+	for (e = list_begin(&p->mappers); e != list_end(&p->mappers); e = list_next(e))
+		if (!frame_begin_evict(list_entry(e, struct pcache_mapping, elem)->spte)){
+			for (f = list_begin(&p->mappers); f != e; f = list_next(f))
+				frame_end_evict(list_entry(f, struct pcache_mapping, elem)->spte);
+			return false;
+		}
+	return true;
+}
+
+/*Function to take a mapped page from its mappers and out of the table,
+used when the cache is full of mapped pages, so a large mapping cycles
+through it instead of falling back to private copies. The reverse map
+finds every process mapping the page, it is unmapped from all of them and
+written back once however many wrote to it. The write happens without
+pcache_lock, with the page still in the table so nobody reads the old data
+from the file meanwhile; the page is only taken if it is unused and clean
+afterwards. Returns the page, with its inode left for the caller to close,
+or NULL if no mapped page can be taken*/
+static struct pcache_page *pcache_reclaim (void){
+	struct pcache_page *p = NULL;
+	size_t n, i;
+
+	lock_acquire(&pcache_lock);
+	n = list_size(&mapped);
+	//Two rounds give every page its second chance
+	for (i = 0; i < 2 * n && p == NULL; i++){
+		struct pcache_page *q = list_entry(list_pop_front(&mapped), struct pcache_page, map_elem);
+		list_push_back(&mapped, &q->map_elem);
+		if (pcache_reclaimable(q) && pcache_claim(q))
+			p = q;
+	}
+	if (p == NULL){
+		lock_release(&pcache_lock);
+		return NULL;
+	}
+	while (!list_empty(&p->mappers)){
+		struct pcache_mapping *m = list_entry(list_front(&p->mappers), struct pcache_mapping, elem);
+		struct sup_page_table_entry *spte = m->spte;
+		pcache_detach(p, m);
+		frame_end_evict(spte);
+	}
+	//The references of the mappings become the one of this thread
+	p->ref_cnt = 1;
+	bool dirty = p->dirty;
+	p->dirty = false;
+	lock_release(&pcache_lock);
+
+	bool ok = true;
+	if (dirty){
+		lock_acquire(&p->lock);
+		ok = pcache_write_page(p);
+		lock_release(&p->lock);
+	}
+
+	lock_acquire(&pcache_lock);
+	if (!ok)
+		p->dirty = true;
+	if (p->ref_cnt == 1 && !p->dirty){
+		hash_delete(&pages, &p->elem);
+		page_cnt--;
+		reclaim_cnt++;
+		lock_release(&pcache_lock);
+		return p;
+	}
+	//Used again meanwhile, or the data is not in the file yet
+	lock_release(&pcache_lock);
+	pcache_put(p);
+	return NULL;
+}
+
+/*Function to give back page P taken out of the table but not reused*/
+static void pcache_free (struct pcache_page *p){
+	inode_close(p->inode);
+	palloc_free_page(p->kpage);
+	free(p);
+}
+
+/*Function to return page INDEX of INODE with a reference taken, reading it
+in if needed. Returns NULL if the page is not cached and neither a free
+frame nor an idle page can be had, the caller then goes to the file. To be
+MAPPED, a page is also taken from the mappers of another one if needed*/
+static struct pcache_page *pcache_get (struct inode *inode, size_t index, bool mapped){
+	struct pcache_page *spare = NULL;
+	struct pcache_page *p;
+	struct inode *old_inode = NULL;
+
+	for (;;){
+		lock_acquire(&pcache_lock);
+		p = pcache_find(inode, index);
+		if (p != NULL){
+			hit_cnt++;
+			lock_release(&pcache_lock);
+			if (spare != NULL)
+				pcache_free(spare);
+			//Wait for the thread reading it in, a valid page needs no lock
+			if (!p->valid){
+				lock_acquire(&p->lock);
+				lock_release(&p->lock);
+			}
+			return p;
+		}
+		if (spare != NULL){
+			p = spare;
+			old_inode = p->inode;
+			break;
+		}
+
+		void *kpage = page_cnt < PCACHE_SIZE ? palloc_get_page(PAL_USER) : NULL;
+		if (kpage != NULL){
+			p = malloc(sizeof(struct pcache_page));
+			if (p == NULL){
+				palloc_free_page(kpage);
+				lock_release(&pcache_lock);
+				return NULL;
+			}
+			lock_init(&p->lock);
+			list_init(&p->mappers);
+			p->dirty = false;
+			p->kpage = kpage;
+			break;
+		}
+		//Reuse the page least recently used
+		p = pcache_take_idle();
+		if (p != NULL){
+			old_inode = p->inode;
+			break;
+		}
+		lock_release(&pcache_lock);
+		//Then one taken from its mappers, the table may change meanwhile
+		if (!mapped || (spare = pcache_reclaim()) == NULL)
+			return NULL;
+	}
+	p->inode = inode_reopen(inode);
+	p->index = index;
+	p->ref_cnt = 1;
+	p->valid = false;
+	p->referenced = true;
+	lock_acquire(&p->lock);
+	hash_insert(&pages, &p->elem);
+	page_cnt++;
+	miss_cnt++;
+	lock_release(&pcache_lock);
+	inode_close(old_inode);
+
+	off_t ofs = (off_t) index * PGSIZE;
+	off_t n = inode_read_at(inode, p->kpage, PGSIZE, ofs);
+	if (n < 0)
+		n = 0;
+	memset((uint8_t *) p->kpage + n, 0, PGSIZE - n);
+	//Let the buffer cache fetch the next page while this one is copied
+	if (n == PGSIZE)
+		inode_readahead(inode, ofs + PGSIZE, PGSIZE);
+	p->valid = true;
+	lock_release(&p->lock);
+	return p;
+}
+
+/*Function to drop a reference taken by pcache_get() or pcache_find(). The
+last one frees a page of a removed file, whose reference to the inode
+would otherwise keep its sectors allocated*/
+static void pcache_put (struct pcache_page *p){
+	bool drop = false;
+	lock_acquire(&pcache_lock);
+	if (--p->ref_cnt == 0){
+		drop = inode_is_removed(p->inode);
+		if (drop){
+			hash_delete(&pages, &p->elem);
+			page_cnt--;
+		}
+		else
+			list_push_back(&idle, &p->lru_elem);
+	}
+	lock_release(&pcache_lock);
+	if (drop)
+		pcache_free(p);
+}
+
+/*Function to read SIZE bytes of INODE at OFFSET into BUFFER through the
+cache, works like inode_read_at()*/
+off_t pcache_read_at (struct inode *inode, void *buffer, off_t size, off_t offset){
+	uint8_t *buf = buffer;
+	off_t length = inode_length(inode);
+	off_t bytes_read = 0;
+
+	if (offset >= length)
+		return 0;
+	if (size > length - offset)
+		size = length - offset;
+	while (size > 0){
+		size_t page_ofs = offset % PGSIZE;
+		off_t chunk = PGSIZE - page_ofs;
+		if (chunk > size)
+			chunk = size;
+		struct pcache_page *p = pcache_get(inode, offset / PGSIZE, false);
+		if (p == NULL){
+			//No memory for the cache, read the rest directly
+			return bytes_read + inode_read_at(inode, buf, size, offset);
+		}
+		//The copy may fault on a user buffer, no lock is held for it
+		memcpy(buf, (uint8_t *) p->kpage + page_ofs, chunk);
+		pcache_put(p);
+		buf += chunk;
+		offset += chunk;
+		size -= chunk;
+		bytes_read += chunk;
+	}
+	return bytes_read;
+}
+
+/*Function to read the CNT pages of INODE at the page aligned OFFSETS, in
+ascending order, into the cache in one pass. The buffer cache is asked for
+the sectors of every run of pages first, so the disk keeps reading while
+the earlier pages are copied in. Stops once the cache has no page to spare*/
+void pcache_prefetch (struct inode *inode, const off_t *offsets, int cnt){
+	int i, run;
+	for (i = 0; i < cnt; i = run){
+		for (run = i + 1; run < cnt && offsets[run] <= offsets[run - 1] + PGSIZE; run++)
+			continue;
+		inode_readahead(inode, offsets[i], offsets[run - 1] + PGSIZE - offsets[i]);
+	}
+	for (i = 0; i < cnt; i++){
+		struct pcache_page *p = pcache_get(inode, offsets[i] / PGSIZE, false);
+		if (p == NULL)
+			break;
+		pcache_put(p);
+	}
+}
+
+/*Function to read from FILE's current position through the cache, works
+like file_read()*/
+off_t pcache_read (struct file *file, void *buffer, off_t size){
+	off_t pos = file_tell(file);
+	//Sequential reads widen the file's read-ahead window as in file_read()
+	file_readahead(file, size);
+	off_t n = pcache_read_at(file_get_inode(file), buffer, size, pos);
+	file_seek(file, pos + n);
+	return n;
+}
+
+/*Function to zero the bytes of INODE's cached page past LENGTH, before the
+file grows over them. They may hold writes through a mapping of the last
+page, which never reach the file*/
+static void pcache_clear_tail (struct inode *inode, off_t length){
+	if (length % PGSIZE == 0)
+		return;
+	lock_acquire(&pcache_lock);
+	struct pcache_page *p = pcache_find(inode, length / PGSIZE);
+	lock_release(&pcache_lock);
+	if (p == NULL)
+		return;
+	lock_acquire(&p->lock);
+	memset((uint8_t *) p->kpage + length % PGSIZE, 0, PGSIZE - length % PGSIZE);
+	lock_release(&p->lock);
+	pcache_put(p);
+}
+
+/*Function to write SIZE bytes of BUFFER to FILE at OFFSET, works like
+file_write_at(). The file is written first and the cached copy of each page after it, under
+the page's lock so two writers update both in the same order. Pages that
+are not cached are left alone, a page read in during the write is looked
+up again afterwards and fixed. A user BUFFER is copied to the kernel a page
+at a time before any lock is taken, a fault on it may read in a page of
+this very file*/
+off_t pcache_write_at (struct file *file, const void *buffer, off_t size, off_t offset){
+	struct inode *inode = file_get_inode(file);
+	const uint8_t *buf = buffer;
+	off_t length = inode_length(inode);
+	off_t bytes_written = 0;
+	uint8_t *bounce = NULL;
+
+	if (size > 0 && is_user_vaddr(buffer)){
+		bounce = malloc(PGSIZE);
+		if (bounce == NULL)
+			return 0;
+	}
+
+	if (offset + size > length)
+		pcache_clear_tail(inode, length);
+	while (size > 0){
+		size_t page_ofs = offset % PGSIZE;
+		off_t chunk = PGSIZE - page_ofs;
+		if (chunk > size)
+			chunk = size;
+		const uint8_t *src = buf;
+		if (bounce != NULL){
+			memcpy(bounce, buf, chunk);
+			src = bounce;
+		}
+		lock_acquire(&pcache_lock);
+		struct pcache_page *p = pcache_find(inode, offset / PGSIZE);
+		lock_release(&pcache_lock);
+		if (p != NULL)
+			lock_acquire(&p->lock);
+		off_t n = file_write_at(file, src, chunk, offset);
+		if (p == NULL && n > 0){
+			lock_acquire(&pcache_lock);
+			p = pcache_find(inode, offset / PGSIZE);
+			lock_release(&pcache_lock);
+			if (p != NULL)
+				lock_acquire(&p->lock);
+		}
+		if (p != NULL){
+			memcpy((uint8_t *) p->kpage + page_ofs, src, n);
+			lock_release(&p->lock);
+			pcache_put(p);
+		}
+		bytes_written += n;
+		if (n < chunk)
+			break;
+		buf += chunk;
+		offset += chunk;
+		size -= chunk;
+	}
+	free(bounce);
+	return bytes_written;
+}
+
+/*Function to write to FILE's current position through the cache, works
+like file_write()*/
+off_t pcache_write (struct file *file, const void *buffer, off_t size){
+	off_t pos = file_tell(file);
+	off_t n = pcache_write_at(file, buffer, size, pos);
+	file_seek(file, pos + n);
+	return n;
+}
+
+/*Function to map the page of INODE at OFFSET, a multiple of PGSIZE, at
+SPTE's page of the current process and add the mapping to the page's
+reverse map. Every process mapping the page shares its one frame. Returns
+false if the page cannot be cached, the caller then reads a private copy*/
+bool pcache_map (struct inode *inode, off_t offset, struct sup_page_table_entry *spte){
+	ASSERT(offset % PGSIZE == 0);
+	struct thread *t = thread_current();
+	struct pcache_mapping *m = malloc(sizeof(struct pcache_mapping));
+	if (m == NULL)
+		return false;
+	struct pcache_page *p = pcache_get(inode, offset / PGSIZE, true);
+	if (p == NULL){
+		free(m);
+		return false;
+	}
+	m->owner = t;
+	m->spte = spte;
+	//Installed under the lock, so a page found in a page table is always in
+	//the reverse map too
+	lock_acquire(&pcache_lock);
+	if (!pagedir_set_page(t->pagedir, spte->uva, p->kpage, spte->writable)){
+		lock_release(&pcache_lock);
+		free(m);
+		pcache_put(p);
+		return false;
+	}
+	if (list_empty(&p->mappers))
+		list_push_back(&mapped, &p->map_elem);
+	list_push_back(&p->mappers, &m->elem);
+	spte->pcache = p;
+	spte->is_loaded = true;
+	map_cnt++;
+	lock_release(&pcache_lock);
+	return true;
+}
+
+/*Function to remove the current process's mapping at SPTE. When the last
+mapper goes the page is written back, once, if any of them wrote to it,
+and *WRITTEN, unless it is NULL, tells whether that worked. Returns false
+if SPTE is not mapped to a cached page, which is also the case once the
+page has been taken from its mappers*/
+bool pcache_unmap (struct sup_page_table_entry *spte, bool *written){
+	lock_acquire(&pcache_lock);
+	struct pcache_page *p = spte->pcache;
+	if (p == NULL){
+		lock_release(&pcache_lock);
+		return false;
+	}
+	struct list_elem *e = list_begin(&p->mappers);
+	while (list_entry(e, struct pcache_mapping, elem)->spte != spte)
+		e = list_next(e);
+	pcache_detach(p, list_entry(e, struct pcache_mapping, elem));
+	bool dirty = p->dirty && list_empty(&p->mappers);
+	if (dirty)
+		p->dirty = false;
+	lock_release(&pcache_lock);
+
+	bool ok = true;
+	if (dirty){
+		lock_acquire(&p->lock);
+		ok = pcache_write_page(p);
+		lock_release(&p->lock);
+	}
+	if (!ok){
+		//Kept for pcache_sync() to retry, the page is not reused meanwhile
+		lock_acquire(&pcache_lock);
+		p->dirty = true;
+		lock_release(&pcache_lock);
+	}
+	if (written != NULL)
+		*written = ok;
+	//The reference of the mapping
+	pcache_put(p);
+	return true;
+}
+
+/*Function to write back the pages of INODE, or of every file if INODE is
+NULL, that have been written to through mappings. The reverse map gives
+the dirty bits of all the mappers of a page, they are cleared and the page
+is written once. Pages whose earlier write back failed are retried. Returns
+false if a page could not be written, it then stays dirty*/
+bool pcache_sync (struct inode *inode){
+	struct pcache_page *dirty[PCACHE_SIZE];
+	size_t cnt = 0;
+	size_t i;
+	struct hash_iterator it;
+	struct list_elem *f;
+	bool ok = true;
+
+	lock_acquire(&pcache_lock);
+	hash_first(&it, &pages);
+	while (hash_next(&it)){
+		struct pcache_page *p = hash_entry(hash_cur(&it), struct pcache_page, elem);
+		if (inode != NULL && p->inode != inode)
+			continue;
+		for (f = list_begin(&p->mappers); f != list_end(&p->mappers); f = list_next(f)){
+			struct pcache_mapping *m = list_entry(f, struct pcache_mapping, elem);
+			uint32_t *pd = m->owner->pagedir;
+			if (pd != NULL && pagedir_is_dirty(pd, m->spte->uva)){
+				pagedir_set_dirty(pd, m->spte->uva, false);
+				p->dirty = true;
+			}
+		}
+		if (p->dirty){
+			//Every page in the table fits
+			p->dirty = false;
+			if (p->ref_cnt++ == 0)
+				list_remove(&p->lru_elem);
+			dirty[cnt++] = p;
+		}
+	}
+	lock_release(&pcache_lock);
+
+	for (i = 0; i < cnt; i++){
+		struct pcache_page *p = dirty[i];
+		lock_acquire(&p->lock);
+		bool written = pcache_write_page(p);
+		lock_release(&p->lock);
+		if (!written){
+			lock_acquire(&pcache_lock);
+			p->dirty = true;
+			lock_release(&pcache_lock);
+			ok = false;
+		}
+		pcache_put(p);
+	}
+	return ok;
+}
+
+/*Function to drop the idle pages of INODE, called once it is removed. Pages
+in use are dropped by pcache_put() when their last user is done*/
+void pcache_invalidate (struct inode *inode){
+	struct list dropped;
+	struct list_elem *e, *next;
+	list_init(&dropped);
+	lock_acquire(&pcache_lock);
+	for (e = list_begin(&idle); e != list_end(&idle); e = next){
+		struct pcache_page *p = list_entry(e, struct pcache_page, lru_elem);
+		next = list_next(e);
+		if (p->inode != inode)
+			continue;
+		list_remove(&p->lru_elem);
+		hash_delete(&pages, &p->elem);
+		page_cnt--;
+		list_push_back(&dropped, &p->lru_elem);
+	}
+	lock_release(&pcache_lock);
+	while (!list_empty(&dropped))
+		pcache_free(list_entry(list_pop_front(&dropped), struct pcache_page, lru_elem));
+}
+
+/*Function to write back and free every idle page at shutdown, before the
+file system is done, so no cached page keeps an inode open*/
+void pcache_done (void){
+	lock_acquire(&pcache_lock);
+	while (!list_empty(&idle)){
+		struct pcache_page *p = list_entry(list_pop_front(&idle), struct pcache_page, lru_elem);
+		hash_delete(&pages, &p->elem);
+		page_cnt--;
+		lock_release(&pcache_lock);
+		if (p->dirty && !inode_is_removed(p->inode) && !pcache_write_page(p))
+			printf("pcache_done: cannot write back page %zu of inode %u\n",
+			       p->index, (unsigned) inode_get_inumber(p->inode));
+		pcache_free(p);
+		lock_acquire(&pcache_lock);
+	}
+	lock_release(&pcache_lock);
+}
+
+/*Function to give the frame of one idle page back to the user pool, called
+when user memory runs out. Returns false if every page is in use*/
+bool pcache_shrink (void){
+	lock_acquire(&pcache_lock);
+	struct pcache_page *p = pcache_take_idle();
+	lock_release(&pcache_lock);
+	if (p == NULL)
+		return false;
+	pcache_free(p);
+	return true;
+}
+
+/*Prints page cache statistics*/
+void pcache_print_stats (void){
+	printf("Page cache: %lld hits, %lld misses, %lld pages mapped, "
+	       "%lld written back, %lld taken from mappers\n",
+	       hit_cnt, miss_cnt, map_cnt, writeback_cnt, reclaim_cnt);
+}
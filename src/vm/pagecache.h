@@ -0,0 +1,36 @@
+#ifndef VM_PAGECACHE_H
+#define VM_PAGECACHE_H
+
+#include <stdbool.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+
+/*Page cache: whole pages of file data keyed by (inode, page index), shared
+by the read and write system calls, executable loading and file mappings.
+A mapped page is the cached page itself, so a process reading a file and
+another one mapping it see one copy that is read from disk once. A reverse
+map of each page lists the processes mapping it, so what they write is
+written back once, and a page can be taken from all of them when the
+cache is full*/
+
+#define PCACHE_SIZE 64
+//Most pages cached at once, mapped ones included
+
+struct pcache_page;
+struct sup_page_table_entry;
+
+void pcache_init (void);
+off_t pcache_read_at (struct inode *inode, void *buffer, off_t size, off_t offset);
+off_t pcache_read (struct file *file, void *buffer, off_t size);
+void pcache_prefetch (struct inode *inode, const off_t *offsets, int cnt);
+off_t pcache_write_at (struct file *file, const void *buffer, off_t size, off_t offset);
+off_t pcache_write (struct file *file, const void *buffer, off_t size);
+bool pcache_map (struct inode *inode, off_t offset, struct sup_page_table_entry *spte);
+bool pcache_unmap (struct sup_page_table_entry *spte, bool *written);
+bool pcache_sync (struct inode *inode);
+void pcache_invalidate (struct inode *inode);
+void pcache_done (void);
+bool pcache_shrink (void);
+void pcache_print_stats (void);
+
+#endif /* vm/pagecache.h */
@@ -0,0 +1,177 @@
+#include "vm/prefetch.h"
+#include "vm/page.h"
+#include "vm/pagecache.h"
+#include "devices/timer.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include <list.h>
+#include <stdio.h>
+
+#define PREFETCH_MAX_PAGES 64
+//Upper bound of pages in one profile, 256 kB of code and data
+#define PREFETCH_WINDOW_TICKS (TIMER_FREQ / 10)
+//Faults in the first 100 ms of a run are part of its launch profile
+#define PREFETCH_MAX_PROFILES 32
+//Profiles kept at once, the least recently used one is dropped
+
+struct launch_profile {
+	block_sector_t inumber;
+	// Inode sector of the executable
+	int64_t start;
+	// Tick at which recording started, only used while recording
+	int page_cnt;
+	// Number of valid entries in pages
+	void *pages[PREFETCH_MAX_PAGES];
+	// User pages in the order they were first faulted in
+	struct list_elem elem;
+};
+
+bool prefetch_enabled = true;
+
+static struct list profiles;
+/*Recorded profiles, most recently used first*/
+static struct lock profile_lock;
+
+static long long profile_cnt;
+static long long prefetch_cnt;
+/*Both protected by profile_lock*/
+
+/*Function to initialize the profile list and lock*/
+void prefetch_init (void){
+	list_init(&profiles);
+	lock_init(&profile_lock);
+}
+
+/*Function to find the profile of the executable at INUMBER, must hold profile_lock*/
+static struct launch_profile *profile_lookup (block_sector_t inumber){
+	struct list_elem *e;
+	for (e = list_begin(&profiles); e != list_end(&profiles); e = list_next(e)){
+		struct launch_profile *p = list_entry(e, struct launch_profile, elem);
+		if (p->inumber == inumber)
+			return p;
+	}
+	return NULL;
+}
+
+/*Function to load every page of the profile that is still a not loaded
+page of INODE. The pages are read into the page cache in one pass in file
+offset order, so the executable is read front to back, and only then
+mapped, copying from the cache*/
+static void profile_replay (struct inode *inode, void **pages, int page_cnt){
+	struct sup_page_table_entry *sptes[PREFETCH_MAX_PAGES];
+	off_t offsets[PREFETCH_MAX_PAGES];
+	int cnt = 0;
+	int i, j;
+	for (i = 0; i < page_cnt; i++){
+		struct sup_page_table_entry *spte = get_spte(pages[i]);
+		if (spte == NULL || spte->is_loaded || spte->type != FILE
+		    || file_get_inode(spte->file) != inode)
+			continue;
+		//insertion sort on the offset, profiles are short
+		for (j = cnt; j > 0 && sptes[j - 1]->offset > spte->offset; j--)
+			sptes[j] = sptes[j - 1];
+		sptes[j] = spte;
+		cnt++;
+	}
+	for (i = 0; i < cnt; i++)
+		offsets[i] = sptes[i]->offset;
+	pcache_prefetch(inode, offsets, cnt);
+
+	for (i = 0; i < cnt; i++)
+		if (!page_load_file(sptes[i]))
+			break;
+	lock_acquire(&profile_lock);
+	prefetch_cnt += i;
+	lock_release(&profile_lock);
+}
+
+/*Function called by load() once the segments of EXEC are registered.
+Replays the executable's profile if there is one, otherwise starts
+recording a new one*/
+void prefetch_start (struct file *exec){
+	struct thread *t = thread_current();
+	block_sector_t inumber = inode_get_inumber(file_get_inode(exec));
+	void *pages[PREFETCH_MAX_PAGES];
+	int page_cnt = 0;
+
+	t->launch_record = NULL;
+	if (!prefetch_enabled)
+		return;
+
+	lock_acquire(&profile_lock);
+	struct launch_profile *p = profile_lookup(inumber);
+	if (p != NULL){
+		//Copy the pages out so we do not hold the lock while reading
+		list_remove(&p->elem);
+		list_push_front(&profiles, &p->elem);
+		page_cnt = p->page_cnt;
+		for (int i = 0; i < page_cnt; i++)
+			pages[i] = p->pages[i];
+	}
+	lock_release(&profile_lock);
+
+	if (p != NULL){
+		profile_replay(file_get_inode(exec), pages, page_cnt);
+		return;
+	}
+
+	struct launch_profile *rec = malloc(sizeof(struct launch_profile));
+	if (rec == NULL)
+		return;
+	rec->inumber = inumber;
+	rec->start = timer_ticks();
+	rec->page_cnt = 0;
+	t->launch_record = rec;
+}
+
+/*Function called for every file page faulted in by the current process*/
+void prefetch_record (const void *uva){
+	struct launch_profile *rec = thread_current()->launch_record;
+	if (rec == NULL)
+		return;
+	if (timer_elapsed(rec->start) > PREFETCH_WINDOW_TICKS){
+		prefetch_finish();
+		return;
+	}
+	rec->pages[rec->page_cnt++] = pg_round_down(uva);
+	if (rec->page_cnt == PREFETCH_MAX_PAGES)
+		prefetch_finish();
+}
+
+/*Function to stop recording, called when the window is over, the
+profile is full or the process exits. Publishes the profile unless
+another run of the same executable already did*/
+void prefetch_finish (void){
+	struct thread *t = thread_current();
+	struct launch_profile *rec = t->launch_record;
+	if (rec == NULL)
+		return;
+	t->launch_record = NULL;
+	if (rec->page_cnt == 0){
+		free(rec);
+		return;
+	}
+
+	lock_acquire(&profile_lock);
+	if (profile_lookup(rec->inumber) != NULL){
+		lock_release(&profile_lock);
+		free(rec);
+		return;
+	}
+	if (list_size(&profiles) >= PREFETCH_MAX_PROFILES){
+		struct launch_profile *old = list_entry(list_pop_back(&profiles), struct launch_profile, elem);
+		free(old);
+	}
+	list_push_front(&profiles, &rec->elem);
+	profile_cnt++;
+	lock_release(&profile_lock);
+}
+
+/*Prints launch profile statistics*/
+void prefetch_print_stats (void){
+	printf("Prefetch: %lld launch profiles recorded, %lld pages prefetched\n",
+	       profile_cnt, prefetch_cnt);
+}
@@ -0,0 +1,21 @@
+#ifndef VM_PREFETCH_H
+#define VM_PREFETCH_H
+
+#include <stdbool.h>
+#include "filesys/file.h"
+
+/*Launch profiles: the pages an executable faults in during the first
+PREFETCH_WINDOW_TICKS of a run are recorded per executable inode, and
+read into the page cache in one sorted batch on later execs before the
+process starts*/
+
+extern bool prefetch_enabled;
+/*Cleared by the -no-prefetch kernel option*/
+
+void prefetch_init (void);
+void prefetch_start (struct file *exec);
+void prefetch_record (const void *uva);
+void prefetch_finish (void);
+void prefetch_print_stats (void);
+
+#endif /* vm/prefetch.h */
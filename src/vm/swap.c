@@ -42,3 +42,11 @@ void swap_in(size_t swap_index, void* uva)
     bitmap_flip(swap_map, swap_index);
     lock_release(&swap_lock);
 }
+
+/*release a swap slot whose page is no longer needed without reading it back*/
+void swap_free(size_t swap_index)
+{
+    lock_acquire(&swap_lock);
+    bitmap_reset(swap_map, swap_index);
+    lock_release(&swap_lock);
+}
@@ -13,4 +13,5 @@
 void swap_init(void);
 size_t swap_out(void *frame);
 void swap_in(size_t swap_index, void* uva);
+void swap_free(size_t swap_index);
 #endif 